@@ -0,0 +1,317 @@
+// Headless benchmarks for the scene library. Builds a synthetic scene of grid
+// modules with random walls and connections, times the core operations on it
+// and prints the results as JSON, so runs from different builds can be compared.
+//
+//   scene_bench [--modules N] [--grid N] [--walls N] [--edges N] [--iterations N] [--seed N]
+//               [--kernel scalar|sse|avx2] [--output file]
+#include "scene.h"
+#include "ray_kernels.h"
+#include <chrono>
+#include <cfloat>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+struct BenchConfig {
+    int modules = 16;
+    int grid = 10;          // Nodes per grid edge, so grid^3 nodes per module
+    int walls = 200;        // Random walls per module
+    int edges = 500;        // Random extra connections per module
+    int iterations = 10000; // Operations per timed benchmark
+    unsigned int seed = 1;
+    RayKernelISA kernel = RAY_KERNEL_AVX2; // Lowered to what the CPU supports
+    const char* output = nullptr;
+};
+
+struct BenchResult {
+    std::string name;
+    int iterations;
+    double totalMs;
+    int hits = -1; // Picking benchmarks: rays that hit something
+};
+
+struct BenchScene {
+    std::vector<GridModule> modules;
+    SceneGraph graph;
+    ScenePickBVH pick;
+    int nextModuleId = 0;
+};
+
+static const float MODULE_SIZE = 12.0f;
+static const float MODULE_SPACING = 15.0f;
+static const float SPHERE_RADIUS = 0.3f;
+
+template <typename Fn>
+BenchResult Measure(const char* name, int iterations, Fn fn) {
+    auto start = std::chrono::steady_clock::now();
+    fn();
+    auto end = std::chrono::steady_clock::now();
+    return {name, iterations, std::chrono::duration<double, std::milli>(end - start).count()};
+}
+
+// Corners of one random face of a grid cell, in order around the face
+std::vector<int> RandomGridFace(std::mt19937& rng, int grid) {
+    std::uniform_int_distribution<int> cell(0, grid - 2);
+    int x = cell(rng), y = cell(rng), z = cell(rng);
+    int axis = (int)(rng() % 3);
+    int step[3] = {1, grid, grid * grid};
+    int base = x * step[0] + y * step[1] + z * step[2];
+    int u = step[(axis + 1) % 3];
+    int v = step[(axis + 2) % 3];
+    return {base, base + u, base + u + v, base + v};
+}
+
+void BuildBenchScene(const BenchConfig& config, BenchScene& scene, std::mt19937& rng) {
+    for (int m = 0; m < config.modules; m++) {
+        GridModule module;
+        module.center = {m * MODULE_SPACING, 5.0f, 0.0f};
+        module.nodes = Create3DGridStructure(module.center, MODULE_SIZE, config.grid);
+        module.id = scene.nextModuleId++;
+        
+        for (int w = 0; w < config.walls; w++) {
+            CreateWallFromSelectedNodes(module, RandomGridFace(rng, config.grid));
+        }
+        int count = NodeCount(module.nodes);
+        for (int e = 0; e < config.edges; e++) {
+            int a = (int)(rng() % count);
+            int b = (int)(rng() % count);
+            if (a != b && !HasEdge(module.nodes, a, b)) AddEdge(module.nodes, a, b);
+        }
+        MarkModuleChanged(module);
+        scene.modules.push_back(std::move(module));
+    }
+    UpdateScenePicking(scene.modules, scene.pick);
+}
+
+// Rays from random points around the scene towards random points near a module,
+// as a CPU-side stand-in for GetMouseRay. targets receives the module each ray aims at.
+std::vector<Ray> RandomRays(const BenchScene& scene, std::mt19937& rng, int count, std::vector<int>& targets) {
+    std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+    std::vector<Ray> rays;
+    rays.reserve(count);
+    targets.clear();
+    for (int i = 0; i < count; i++) {
+        targets.push_back((int)(rng() % scene.modules.size()));
+        const GridModule& module = scene.modules[targets.back()];
+        Vector3 target = Vector3Add(module.center, Vector3Scale({unit(rng), unit(rng), unit(rng)}, MODULE_SIZE * 0.5f));
+        Vector3 origin = Vector3Add(target, Vector3Scale(Vector3Normalize({unit(rng), unit(rng) + 1.5f, unit(rng)}), 40.0f));
+        rays.push_back({origin, Vector3Normalize(Vector3Subtract(target, origin))});
+    }
+    return rays;
+}
+
+std::vector<BenchResult> RunBenchmarks(const BenchConfig& config) {
+    std::mt19937 rng(config.seed);
+    std::vector<BenchResult> results;
+    
+    BenchScene scene;
+    results.push_back(Measure("build_scene", config.modules, [&]() { BuildBenchScene(config, scene, rng); }));
+    
+    // One million-node module, as a large N-key module or startup lattice would be
+    results.push_back(Measure("create_lattice_100", 1, [&]() {
+        NodeStore lattice = Create3DGridStructure({0.0f, 0.0f, 0.0f}, 100, 100, 100, {1.0f, 1.0f, 1.0f});
+        if (NodeCount(lattice) != 1000000) fprintf(stderr, "Unexpected lattice size\n");
+    }));
+    
+    std::vector<int> targets;
+    std::vector<Ray> rays = RandomRays(scene, rng, config.iterations, targets);
+    int hits = 0;
+    results.push_back(Measure("pick_node_under_ray", config.iterations, [&]() {
+        for (const Ray& ray : rays) {
+            int m = GetModuleUnderRay(scene.modules, scene.pick, ray, SPHERE_RADIUS);
+            if (m != -1 && GetNodeUnderRay(scene.modules[m], ray, SPHERE_RADIUS) != -1) hits++;
+        }
+    }));
+    results.back().hits = hits;
+    hits = 0;
+    // Every node of the target module, without the BVH, as picking does right after an edit
+    results.push_back(Measure("pick_node_linear", config.iterations, [&]() {
+        for (size_t i = 0; i < rays.size(); i++) {
+            const NodeStore& nodes = scene.modules[targets[i]].nodes;
+            RayHit hit = IntersectRaySpheres(rays[i], nodes.x.data(), nodes.y.data(), nodes.z.data(), nodes.alive.data(),
+                                             NodeCount(nodes), SPHERE_RADIUS, FLT_MAX);
+            if (hit.index != -1) hits++;
+        }
+    }));
+    results.back().hits = hits;
+    hits = 0;
+    // The same lattices kept implicit, picked by walking their cells instead of a tree
+    std::vector<GridModule> lattices(scene.modules.size());
+    for (size_t m = 0; m < lattices.size(); m++) {
+        lattices[m].nodes = CreateImplicitGrid(scene.modules[m].center, MODULE_SIZE, config.grid);
+    }
+    results.push_back(Measure("pick_node_lattice", config.iterations, [&]() {
+        for (size_t i = 0; i < rays.size(); i++) {
+            if (GetNodeUnderRay(lattices[targets[i]], rays[i], SPHERE_RADIUS) != -1) hits++;
+        }
+    }));
+    results.back().hits = hits;
+    hits = 0;
+    results.push_back(Measure("pick_wall_under_ray", config.iterations, [&]() {
+        for (size_t i = 0; i < rays.size(); i++) {
+            if (GetWallUnderRay(scene.modules[targets[i]], rays[i]) != -1) hits++;
+        }
+    }));
+    results.back().hits = hits;
+    
+    // Edits run on a copy so every benchmark starts from the same scene
+    std::vector<GridModule> edited = scene.modules;
+    int gridNodes = config.grid * config.grid * config.grid;
+    results.push_back(Measure("delete_node", config.iterations, [&]() {
+        for (int i = 0; i < config.iterations; i++) {
+            DeleteNode(edited[rng() % edited.size()], (int)(rng() % gridNodes));
+        }
+    }));
+    
+    edited = scene.modules;
+    results.push_back(Measure("create_wall", config.iterations, [&]() {
+        for (int i = 0; i < config.iterations; i++) {
+            CreateWallFromSelectedNodes(edited[rng() % edited.size()], RandomGridFace(rng, config.grid));
+        }
+    }));
+    
+    // The journal replaced whole-scene snapshots, so undo and redo of recorded edits are measured instead
+    edited = scene.modules;
+    SceneGraph editedGraph = scene.graph;
+    int nextModuleId = scene.nextModuleId;
+    EditJournal journal;
+    journal.maxHistory = (size_t)config.iterations;
+    for (int i = 0; i < config.iterations; i++) {
+        GridModule& module = edited[rng() % edited.size()];
+        EditCommand cmd = MakeEdit(EDIT_MOVE_NODE, module.id);
+        cmd.node = (int)(rng() % gridNodes);
+        cmd.from = NodePosition(module.nodes, cmd.node);
+        cmd.to = Vector3Add(cmd.from, {0.5f, 0.0f, 0.0f});
+        PerformEdit(journal, edited, editedGraph, nextModuleId, std::move(cmd));
+    }
+    int journaled = (int)journal.undoStack.size();
+    results.push_back(Measure("undo", journaled, [&]() {
+        while (UndoEdit(journal, edited, editedGraph, nextModuleId)) {}
+    }));
+    results.push_back(Measure("redo", journaled, [&]() {
+        while (RedoEdit(journal, edited, editedGraph, nextModuleId)) {}
+    }));
+    
+    const char* objFile = "scene_bench.obj";
+    results.push_back(Measure("export_obj", 1, [&]() { ExportToOBJ(scene.modules, scene.graph, objFile); }));
+    remove(objFile);
+    
+    const char* projectFile = "scene_bench.gscp";
+    TextureCache textures; // Synthetic walls are untextured, so this stays empty
+    results.push_back(Measure("save_project", 1, [&]() { SaveProject(scene.modules, scene.graph, scene.nextModuleId, projectFile); }));
+    results.push_back(Measure("load_project", 1, [&]() {
+        std::vector<GridModule> loaded;
+        SceneGraph loadedGraph;
+        int loadedNextId = 0;
+        LoadProject(projectFile, loaded, loadedGraph, loadedNextId, textures);
+    }));
+    remove(projectFile);
+    
+    // Page every module out (a zero budget with the focus far away), then back in
+    edited = scene.modules;
+    EditJournal noEdits;
+    ScenePickBVH editedPick;
+    UpdateScenePicking(edited, editedPick);
+    ScenePager pager;
+    pager.pathPrefix = "scene_bench.page";
+    pager.budgetBytes = 0;
+    Vector3 farAway = {1e7f, 1e7f, 1e7f};
+    results.push_back(Measure("page_out", config.modules, [&]() { UpdateScenePaging(pager, edited, noEdits, farAway); }));
+    pager.budgetBytes = (size_t)-1;
+    pager.streamRadius = FLT_MAX;
+    results.push_back(Measure("page_in", config.modules, [&]() {
+        UpdateScenePaging(pager, edited, noEdits, farAway);
+        UpdateScenePicking(edited, editedPick);
+    }));
+    RemoveScenePages(pager);
+    return results;
+}
+
+std::string ResultsToJson(const BenchConfig& config, const std::vector<BenchResult>& results) {
+    std::string json = "{\n  \"config\": {";
+    json += "\"modules\": " + std::to_string(config.modules);
+    json += ", \"grid\": " + std::to_string(config.grid);
+    json += ", \"walls\": " + std::to_string(config.walls);
+    json += ", \"edges\": " + std::to_string(config.edges);
+    json += ", \"iterations\": " + std::to_string(config.iterations);
+    json += ", \"seed\": " + std::to_string(config.seed);
+    json += ", \"kernel\": \"" + std::string(RayKernelISAName(config.kernel)) + "\"";
+    json += "},\n  \"results\": [\n";
+    for (size_t i = 0; i < results.size(); i++) {
+        const BenchResult& r = results[i];
+        char line[256];
+        snprintf(line, sizeof(line), "    {\"name\": \"%s\", \"iterations\": %d, \"total_ms\": %.3f, \"ns_per_op\": %.1f",
+                 r.name.c_str(), r.iterations, r.totalMs, r.iterations > 0 ? r.totalMs * 1e6 / r.iterations : 0.0);
+        json += line;
+        if (r.hits >= 0) json += ", \"hits\": " + std::to_string(r.hits);
+        json += i + 1 < results.size() ? "},\n" : "}\n";
+    }
+    json += "  ]\n}\n";
+    return json;
+}
+
+bool ParseBenchArgs(int argc, char** argv, BenchConfig& config) {
+    const char* kernelName = nullptr;
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        if (i + 1 >= argc) {
+            fprintf(stderr, "Missing value for %s\n", arg);
+            return false;
+        }
+        const char* value = argv[++i];
+        if (strcmp(arg, "--modules") == 0) config.modules = atoi(value);
+        else if (strcmp(arg, "--grid") == 0) config.grid = atoi(value);
+        else if (strcmp(arg, "--walls") == 0) config.walls = atoi(value);
+        else if (strcmp(arg, "--edges") == 0) config.edges = atoi(value);
+        else if (strcmp(arg, "--iterations") == 0) config.iterations = atoi(value);
+        else if (strcmp(arg, "--seed") == 0) config.seed = (unsigned int)strtoul(value, nullptr, 10);
+        else if (strcmp(arg, "--kernel") == 0) kernelName = value;
+        else if (strcmp(arg, "--output") == 0) config.output = value;
+        else {
+            fprintf(stderr, "Unknown option %s\n", arg);
+            return false;
+        }
+    }
+    if (config.modules < 1 || config.grid < 2 || config.iterations < 1) {
+        fprintf(stderr, "Need at least 1 module, a grid of 2 and 1 iteration\n");
+        return false;
+    }
+    if (kernelName) {
+        const RayKernelISA kernels[] = {RAY_KERNEL_SCALAR, RAY_KERNEL_SSE, RAY_KERNEL_AVX2};
+        bool known = false;
+        for (RayKernelISA isa : kernels) {
+            if (strcmp(kernelName, RayKernelISAName(isa)) == 0) {
+                config.kernel = isa;
+                known = true;
+            }
+        }
+        if (!known) {
+            fprintf(stderr, "Unknown kernel %s, expected scalar, sse or avx2\n", kernelName);
+            return false;
+        }
+    }
+    return true;
+}
+
+int main(int argc, char** argv) {
+    BenchConfig config;
+    if (!ParseBenchArgs(argc, argv, config)) return 1;
+    config.kernel = SelectRayKernelISA(config.kernel);
+    
+    std::string json = ResultsToJson(config, RunBenchmarks(config));
+    if (!config.output) {
+        fputs(json.c_str(), stdout);
+        return 0;
+    }
+    FILE* file = fopen(config.output, "w");
+    if (!file) {
+        fprintf(stderr, "Cannot write %s\n", config.output);
+        return 1;
+    }
+    fputs(json.c_str(), file);
+    fclose(file);
+    return 0;
+}
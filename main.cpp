@@ -1,559 +1,668 @@
-#include "raylib.h"
-#include "raymath.h"
-#include <vector>
+#include "scene.h"
+#include "profiler.h"
+#include "rlgl.h"
 #include <cmath>
 #include <cstdio>
-#include <cfloat>
 #include <algorithm>
-#include <deque>
-#include <fstream>
-#include <string>
-#include <ctime>
 
-struct Node {
-    Vector3 position;
-    std::vector<int> connections;
-};
+int GetNodeUnderMouse(const GridModule& module, const Camera3D& camera, float sphereRadius) {
+    return GetNodeUnderRay(module, GetMouseRay(GetMousePosition(), camera), sphereRadius);
+}
 
-struct Wall {
-    std::vector<int> nodeIndices; // Can be 3, 4, or more nodes
-    Texture2D texture; // Texture for this wall
-    bool hasTexture; // Whether this wall has a texture assigned
-};
+int GetModuleUnderMouse(const std::vector<GridModule>& modules, const ScenePickBVH& scene, const Camera3D& camera, float sphereRadius) {
+    return GetModuleUnderRay(modules, scene, GetMouseRay(GetMousePosition(), camera), sphereRadius);
+}
+
+int GetWallUnderMouse(const GridModule& module, const Camera3D& camera) {
+    return GetWallUnderRay(module, GetMouseRay(GetMousePosition(), camera));
+}
 
-struct GridModule {
-    std::vector<Node> nodes;
-    std::vector<Wall> walls;
-    Vector3 center;
-    int id;
+Vector3 GetMouseWorldPosition(const Camera3D& camera, float distance) {
+    Ray ray = GetMouseRay(GetMousePosition(), camera);
+    return Vector3Add(ray.position, Vector3Scale(ray.direction, distance));
+}
+
+// Uploaded front/back meshes of one textured wall, reused until its geometry or texture changes
+struct WallMeshEntry {
+    Mesh front;
+    Mesh back;
+    Material material;
+    std::vector<Vector3> vertices; // Polygon the meshes were built from
+    unsigned int textureId;
+    unsigned int lastUsedFrame;
 };
 
-struct AppState {
-    std::vector<GridModule> modules;
-    int nextModuleId;
+struct WallMeshCache {
+    std::unordered_map<unsigned int, WallMeshEntry> entries; // Keyed by Wall::id
+    std::vector<Vector3> scratch; // Reused polygon buffer for DrawWall
+    unsigned int frame = 0;
+    int uploadsThisFrame = 0;
 };
 
-std::vector<Node> Create3DGridStructure(Vector3 center, float totalSize, int gridDimension) {
-    std::vector<Node> nodes;
-    float spacing = totalSize / (float)(gridDimension - 1);
-    float halfSize = totalSize / 2.0f;
+// Frames an entry may go undrawn before its GPU buffers are released
+static const unsigned int WALL_MESH_CACHE_GRACE_FRAMES = 120;
+
+Mesh AllocWallMesh(int triangleCount) {
+    Mesh mesh = {0};
+    mesh.triangleCount = triangleCount;
+    mesh.vertexCount = triangleCount * 3;
+    mesh.vertices = (float*)MemAlloc(mesh.vertexCount * 3 * sizeof(float));
+    mesh.texcoords = (float*)MemAlloc(mesh.vertexCount * 2 * sizeof(float));
+    mesh.normals = (float*)MemAlloc(mesh.vertexCount * 3 * sizeof(float));
+    return mesh;
+}
+
+// Fill the CPU arrays of both sides of a fan-triangulated polygon with planar UVs
+void FillWallMeshes(const std::vector<Vector3>& vertices, Mesh& mesh, Mesh& backMesh) {
+    int vertexCount = mesh.vertexCount;
+    Vector3 normal = WallNormal(vertices);
+    WallUVFrame frame = ComputeWallUVFrame(vertices);
     
-    for (int z = 0; z < gridDimension; z++) {
-        for (int y = 0; y < gridDimension; y++) {
-            for (int x = 0; x < gridDimension; x++) {
-                Vector3 pos = {
-                    center.x - halfSize + x * spacing,
-                    center.y - halfSize + y * spacing,
-                    center.z - halfSize + z * spacing
-                };
-                nodes.push_back({pos, {}});
-            }
+    // Create triangle fan
+    int idx = 0;
+    for (size_t i = 1; i < vertices.size() - 1; i++) {
+        const Vector3 corners[3] = {vertices[0], vertices[i], vertices[i + 1]};
+        for (const Vector3& p : corners) {
+            Vector2 uv = WallUV(frame, p);
+            mesh.vertices[idx * 3 + 0] = p.x;
+            mesh.vertices[idx * 3 + 1] = p.y;
+            mesh.vertices[idx * 3 + 2] = p.z;
+            mesh.texcoords[idx * 2 + 0] = uv.x;
+            mesh.texcoords[idx * 2 + 1] = uv.y;
+            idx++;
         }
     }
     
-    for (int z = 0; z < gridDimension; z++) {
-        for (int y = 0; y < gridDimension; y++) {
-            for (int x = 0; x < gridDimension; x++) {
-                int currentIdx = z * gridDimension * gridDimension + y * gridDimension + x;
-                
-                if (x < gridDimension - 1) {
-                    int rightIdx = z * gridDimension * gridDimension + y * gridDimension + (x + 1);
-                    nodes[currentIdx].connections.push_back(rightIdx);
-                }
-                if (y < gridDimension - 1) {
-                    int upIdx = z * gridDimension * gridDimension + (y + 1) * gridDimension + x;
-                    nodes[currentIdx].connections.push_back(upIdx);
-                }
-                if (z < gridDimension - 1) {
-                    int frontIdx = (z + 1) * gridDimension * gridDimension + y * gridDimension + x;
-                    nodes[currentIdx].connections.push_back(frontIdx);
-                }
-            }
-        }
+    // Normals
+    for (int i = 0; i < vertexCount; i++) {
+        mesh.normals[i * 3 + 0] = normal.x;
+        mesh.normals[i * 3 + 1] = normal.y;
+        mesh.normals[i * 3 + 2] = normal.z;
     }
-    return nodes;
-}
-
-int GetNodeUnderMouse(const GridModule& module, const Camera3D& camera, float sphereRadius) {
-    Ray ray = GetMouseRay(GetMousePosition(), camera);
-    int closestNode = -1;
-    float closestDist = FLT_MAX;
     
-    for (size_t i = 0; i < module.nodes.size(); i++) {
-        RayCollision collision = GetRayCollisionSphere(ray, module.nodes[i].position, sphereRadius);
-        if (collision.hit && collision.distance < closestDist) {
-            closestDist = collision.distance;
-            closestNode = (int)i;
+    // Back mesh with reversed winding and flipped normals
+    for (int i = 0; i < vertexCount; i += 3) {
+        // Triangle vertices: copy in reverse order
+        backMesh.vertices[(i + 0) * 3 + 0] = mesh.vertices[(i + 2) * 3 + 0];
+        backMesh.vertices[(i + 0) * 3 + 1] = mesh.vertices[(i + 2) * 3 + 1];
+        backMesh.vertices[(i + 0) * 3 + 2] = mesh.vertices[(i + 2) * 3 + 2];
+        
+        backMesh.vertices[(i + 1) * 3 + 0] = mesh.vertices[(i + 1) * 3 + 0];
+        backMesh.vertices[(i + 1) * 3 + 1] = mesh.vertices[(i + 1) * 3 + 1];
+        backMesh.vertices[(i + 1) * 3 + 2] = mesh.vertices[(i + 1) * 3 + 2];
+        
+        backMesh.vertices[(i + 2) * 3 + 0] = mesh.vertices[(i + 0) * 3 + 0];
+        backMesh.vertices[(i + 2) * 3 + 1] = mesh.vertices[(i + 0) * 3 + 1];
+        backMesh.vertices[(i + 2) * 3 + 2] = mesh.vertices[(i + 0) * 3 + 2];
+        
+        // Copy UVs in same reverse order
+        backMesh.texcoords[(i + 0) * 2 + 0] = mesh.texcoords[(i + 2) * 2 + 0];
+        backMesh.texcoords[(i + 0) * 2 + 1] = mesh.texcoords[(i + 2) * 2 + 1];
+        
+        backMesh.texcoords[(i + 1) * 2 + 0] = mesh.texcoords[(i + 1) * 2 + 0];
+        backMesh.texcoords[(i + 1) * 2 + 1] = mesh.texcoords[(i + 1) * 2 + 1];
+        
+        backMesh.texcoords[(i + 2) * 2 + 0] = mesh.texcoords[(i + 0) * 2 + 0];
+        backMesh.texcoords[(i + 2) * 2 + 1] = mesh.texcoords[(i + 0) * 2 + 1];
+        
+        // Flip normals
+        for (int k = 0; k < 3; k++) {
+            backMesh.normals[(i + k) * 3 + 0] = -normal.x;
+            backMesh.normals[(i + k) * 3 + 1] = -normal.y;
+            backMesh.normals[(i + k) * 3 + 2] = -normal.z;
         }
     }
-    return closestNode;
 }
 
-int GetModuleUnderMouse(const std::vector<GridModule>& modules, const Camera3D& camera, float sphereRadius) {
-    Ray ray = GetMouseRay(GetMousePosition(), camera);
-    int closestModule = -1;
-    float closestDist = FLT_MAX;
-    
-    for (size_t m = 0; m < modules.size(); m++) {
-        for (size_t i = 0; i < modules[m].nodes.size(); i++) {
-            RayCollision collision = GetRayCollisionSphere(ray, modules[m].nodes[i].position, sphereRadius);
-            if (collision.hit && collision.distance < closestDist) {
-                closestDist = collision.distance;
-                closestModule = (int)m;
-            }
-        }
+bool SameVertices(const std::vector<Vector3>& a, const std::vector<Vector3>& b) {
+    if (a.size() != b.size()) return false;
+    for (size_t i = 0; i < a.size(); i++) {
+        if (a[i].x != b[i].x || a[i].y != b[i].y || a[i].z != b[i].z) return false;
     }
-    return closestModule;
+    return true;
 }
 
-void ConnectNodeToNearby(GridModule& module, int newNodeIndex, float connectionDistance) {
-    if (newNodeIndex < 0 || newNodeIndex >= (int)module.nodes.size()) return;
+void ReleaseWallMeshEntry(WallMeshEntry& entry) {
+    UnloadMesh(entry.front);
+    UnloadMesh(entry.back);
+    // The texture belongs to the wall, so free the maps instead of calling UnloadMaterial
+    MemFree(entry.material.maps);
+}
+
+// Cached meshes for a textured wall, re-uploaded only when its polygon changed
+WallMeshEntry* GetWallMeshes(WallMeshCache& cache, const Wall& wall, const std::vector<Vector3>& vertices) {
+    auto it = cache.entries.find(wall.id);
+    int triangleCount = (int)vertices.size() - 2;
     
-    Node& newNode = module.nodes[newNodeIndex];
+    if (it != cache.entries.end() && it->second.front.triangleCount != triangleCount) {
+        ReleaseWallMeshEntry(it->second);
+        cache.entries.erase(it);
+        it = cache.entries.end();
+    }
     
-    // Check all other nodes in the same module
-    for (size_t i = 0; i < module.nodes.size(); i++) {
-        if ((int)i == newNodeIndex) continue;
-        
-        float dist = Vector3Distance(newNode.position, module.nodes[i].position);
-        
-        if (dist <= connectionDistance) {
-            // Check if connection already exists
-            bool alreadyConnected = false;
-            for (int conn : newNode.connections) {
-                if (conn == (int)i) {
-                    alreadyConnected = true;
-                    break;
-                }
-            }
-            
-            if (!alreadyConnected) {
-                // Add bidirectional connection
-                newNode.connections.push_back((int)i);
-                module.nodes[i].connections.push_back(newNodeIndex);
-            }
+    if (it == cache.entries.end()) {
+        WallMeshEntry entry;
+        entry.front = AllocWallMesh(triangleCount);
+        entry.back = AllocWallMesh(triangleCount);
+        FillWallMeshes(vertices, entry.front, entry.back);
+        UploadMesh(&entry.front, false);
+        UploadMesh(&entry.back, false);
+        entry.material = LoadMaterialDefault();
+        entry.material.maps[MATERIAL_MAP_DIFFUSE].color = WHITE; // Ensure full opacity
+        entry.vertices = vertices;
+        entry.textureId = 0;
+        cache.uploadsThisFrame += 2;
+        it = cache.entries.emplace(wall.id, entry).first;
+    } else if (!SameVertices(it->second.vertices, vertices)) {
+        // Same triangle count: refill the existing buffers in place
+        WallMeshEntry& entry = it->second;
+        FillWallMeshes(vertices, entry.front, entry.back);
+        for (Mesh* mesh : {&entry.front, &entry.back}) {
+            UpdateMeshBuffer(*mesh, 0, mesh->vertices, mesh->vertexCount * 3 * sizeof(float), 0);
+            UpdateMeshBuffer(*mesh, 1, mesh->texcoords, mesh->vertexCount * 2 * sizeof(float), 0);
+            UpdateMeshBuffer(*mesh, 2, mesh->normals, mesh->vertexCount * 3 * sizeof(float), 0);
         }
+        entry.vertices = vertices;
+        cache.uploadsThisFrame += 2;
     }
+    
+    WallMeshEntry& entry = it->second;
+    if (entry.textureId != wall.texture->texture.id) {
+        entry.material.maps[MATERIAL_MAP_DIFFUSE].texture = wall.texture->texture;
+        entry.textureId = wall.texture->texture.id;
+    }
+    entry.lastUsedFrame = cache.frame;
+    return &entry;
 }
 
-void ConnectNodeToNearbyAcrossModules(std::vector<GridModule>& modules, int targetModuleIndex, int newNodeIndex, float connectionDistance) {
-    if (targetModuleIndex < 0 || targetModuleIndex >= (int)modules.size()) return;
-    if (newNodeIndex < 0 || newNodeIndex >= (int)modules[targetModuleIndex].nodes.size()) return;
-    
-    Node& newNode = modules[targetModuleIndex].nodes[newNodeIndex];
-    
-    // Check all nodes in ALL modules (including the same module)
-    for (size_t m = 0; m < modules.size(); m++) {
-        for (size_t i = 0; i < modules[m].nodes.size(); i++) {
-            // Skip the new node itself
-            if ((int)m == targetModuleIndex && (int)i == newNodeIndex) continue;
-            
-            float dist = Vector3Distance(newNode.position, modules[m].nodes[i].position);
-            
-            if (dist <= connectionDistance) {
-                // Check if connection already exists
-                bool alreadyConnected = false;
-                for (int conn : newNode.connections) {
-                    // For cross-module connections, we store them differently
-                    // We'll use a simple approach: store module index * 10000 + node index
-                    // But actually, let's keep it simple - only connect within same module for now
-                    // and use a global connection system
-                    if ((int)m == targetModuleIndex && conn == (int)i) {
-                        alreadyConnected = true;
-                        break;
-                    }
-                }
-                
-                // For now, only connect within the same module to avoid index issues
-                // But we can extend this later if needed
-                if (!alreadyConnected && (int)m == targetModuleIndex) {
-                    // Add bidirectional connection within same module
-                    newNode.connections.push_back((int)i);
-                    modules[m].nodes[i].connections.push_back(newNodeIndex);
-                }
-            }
+// Release meshes of walls that were deleted (or not drawn for a while) and start a new frame
+void EndWallMeshFrame(WallMeshCache& cache) {
+    for (auto it = cache.entries.begin(); it != cache.entries.end();) {
+        if (cache.frame - it->second.lastUsedFrame > WALL_MESH_CACHE_GRACE_FRAMES) {
+            ReleaseWallMeshEntry(it->second);
+            it = cache.entries.erase(it);
+        } else {
+            ++it;
         }
     }
+    cache.frame++;
+    cache.uploadsThisFrame = 0;
 }
 
-int GetWallUnderMouse(const GridModule& module, const Camera3D& camera) {
-    Ray ray = GetMouseRay(GetMousePosition(), camera);
-    int closestWall = -1;
-    float closestDist = FLT_MAX;
+void UnloadWallMeshCache(WallMeshCache& cache) {
+    for (auto& entry : cache.entries) {
+        ReleaseWallMeshEntry(entry.second);
+    }
+    cache.entries.clear();
+}
+
+// Function to draw a wall with optional texture
+void DrawWall(WallMeshCache& cache, const Wall& wall, const NodeStore& nodes, Color defaultColor, bool useTexture = false) {
+    if (wall.nodeIndices.size() < 3) return;
     
-    for (size_t w = 0; w < module.walls.size(); w++) {
-        const Wall& wall = module.walls[w];
+    if (useTexture && wall.texture) {
+        std::vector<Vector3>& vertices = cache.scratch;
+        vertices.clear();
+        for (int idx : wall.nodeIndices) {
+            if (idx >= 0 && idx < NodeCount(nodes)) {
+                vertices.push_back(NodePosition(nodes, idx));
+            }
+        }
         
-        // Triangulate the polygon and check each triangle
+        if (vertices.size() >= 3) {
+            WallMeshEntry* entry = GetWallMeshes(cache, wall, vertices);
+            DrawMesh(entry->front, entry->material, MatrixIdentity());
+            DrawMesh(entry->back, entry->material, MatrixIdentity());
+        }
+    } else {
+        // Draw without texture (original method)
         for (size_t i = 1; i < wall.nodeIndices.size() - 1; i++) {
-            Vector3 p1 = module.nodes[wall.nodeIndices[0]].position;
-            Vector3 p2 = module.nodes[wall.nodeIndices[i]].position;
-            Vector3 p3 = module.nodes[wall.nodeIndices[i + 1]].position;
-            
-            RayCollision collision = GetRayCollisionTriangle(ray, p1, p2, p3);
-            
-            if (collision.hit && collision.distance < closestDist) {
-                closestDist = collision.distance;
-                closestWall = (int)w;
+            if (wall.nodeIndices[0] >= 0 && wall.nodeIndices[0] < NodeCount(nodes) &&
+                wall.nodeIndices[i] >= 0 && wall.nodeIndices[i] < NodeCount(nodes) &&
+                wall.nodeIndices[i + 1] >= 0 && wall.nodeIndices[i + 1] < NodeCount(nodes)) {
+                Vector3 p1 = NodePosition(nodes, wall.nodeIndices[0]);
+                Vector3 p2 = NodePosition(nodes, wall.nodeIndices[i]);
+                Vector3 p3 = NodePosition(nodes, wall.nodeIndices[i + 1]);
+                
+                DrawTriangle3D(p1, p2, p3, defaultColor);
+                DrawTriangle3D(p3, p2, p1, defaultColor);
             }
         }
     }
-    return closestWall;
 }
 
-Vector3 GetMouseWorldPosition(const Camera3D& camera, float distance) {
-    Ray ray = GetMouseRay(GetMousePosition(), camera);
-    return Vector3Add(ray.position, Vector3Scale(ray.direction, distance));
-}
+// All untextured walls of one module in a single dynamic mesh, both windings,
+// with per-vertex colour so the hovered wall can be highlighted in place
+struct WallBatch {
+    Mesh mesh;
+    int capacity = 0;                 // Vertices allocated in the uploaded buffers
+    std::vector<int> wallFirstVertex; // First batch vertex of each wall, -1 when not batched
+    std::vector<int> texturedWalls;   // Walls drawn through the textured path instead
+    unsigned int revision = 0;        // GridModule::revision the batch was built from
+    int highlightedWall = -1;
+    Color wallColor;
+    Color highlightColor;
+    unsigned int lastUsedFrame = 0;
+};
 
-bool AreNodesCoplanar(const std::vector<Node>& nodes, const std::vector<int>& indices) {
-    if (indices.size() < 3) return false;
-    if (indices.size() == 3) return true; // Triangles are always coplanar
-    
-    // For 4+ points, check if they're on the same plane
-    Vector3 p1 = nodes[indices[0]].position;
-    Vector3 p2 = nodes[indices[1]].position;
-    Vector3 p3 = nodes[indices[2]].position;
-    
-    Vector3 v1 = Vector3Subtract(p2, p1);
-    Vector3 v2 = Vector3Subtract(p3, p1);
-    Vector3 normal = Vector3Normalize(Vector3CrossProduct(v1, v2));
-    
-    // Check if all other points lie on the same plane
-    for (size_t i = 3; i < indices.size(); i++) {
-        Vector3 v3 = Vector3Subtract(nodes[indices[i]].position, p1);
-        float dot = fabs(Vector3DotProduct(normal, v3));
-        if (dot > 1.0f) return false; // Not coplanar
+struct WallBatchCache {
+    std::unordered_map<int, WallBatch> batches; // Keyed by GridModule::id
+    Material material = {};                     // Shared default material, loaded on first draw
+    unsigned int frame = 0;
+    int rebuildsThisFrame = 0;
+};
+
+bool IsBatchedWall(const Wall& wall, int nodeCount) {
+    if (wall.texture || wall.nodeIndices.size() < 3) return false;
+    for (int idx : wall.nodeIndices) {
+        if (idx < 0 || idx >= nodeCount) return false;
     }
-    
     return true;
 }
 
-bool FormValidPolygon(const std::vector<Node>& nodes, const std::vector<int>& indices) {
-    // Any number of points can form a polygon as long as they're coplanar
-    return indices.size() >= 3;
+void SetBatchWallColor(WallBatch& batch, int firstVertex, int vertexCount, Color color) {
+    for (int v = firstVertex; v < firstVertex + vertexCount; v++) {
+        batch.mesh.colors[v * 4 + 0] = color.r;
+        batch.mesh.colors[v * 4 + 1] = color.g;
+        batch.mesh.colors[v * 4 + 2] = color.b;
+        batch.mesh.colors[v * 4 + 3] = color.a;
+    }
+}
+
+int BatchWallVertexCount(const Wall& wall) {
+    return ((int)wall.nodeIndices.size() - 2) * 6; // Fan triangles, front and back
 }
 
-void CreateWallFromSelectedNodes(GridModule& module, const std::vector<int>& selected) {
-    if (selected.size() < 3) return; // Need at least 3 nodes for a triangle
-    if (!AreNodesCoplanar(module.nodes, selected)) return;
+void RebuildWallBatch(WallBatch& batch, const GridModule& module) {
+    int nodeCount = NodeCount(module.nodes);
+    int vertexCount = 0;
+    batch.wallFirstVertex.assign(module.walls.size(), -1);
+    batch.texturedWalls.clear();
+    for (size_t w = 0; w < module.walls.size(); w++) {
+        const Wall& wall = module.walls[w];
+        if (IsBatchedWall(wall, nodeCount)) {
+            batch.wallFirstVertex[w] = vertexCount;
+            vertexCount += BatchWallVertexCount(wall);
+        } else if (wall.texture) {
+            batch.texturedWalls.push_back((int)w);
+        }
+    }
     
-    // Check if wall with these exact nodes already exists
-    for (const auto& wall : module.walls) {
-        std::vector<int> wallNodes = wall.nodeIndices;
-        std::sort(wallNodes.begin(), wallNodes.end());
-        std::vector<int> sortedSelected = selected;
-        std::sort(sortedSelected.begin(), sortedSelected.end());
-        
-        if (wallNodes == sortedSelected) {
-            return; // Wall already exists
+    // Grow with slack so adding a few walls reuses the buffers
+    bool reupload = vertexCount > batch.capacity;
+    if (reupload) {
+        if (batch.capacity > 0) UnloadMesh(batch.mesh);
+        batch.capacity = vertexCount + vertexCount / 2;
+        batch.mesh = Mesh{0};
+        batch.mesh.vertices = (float*)MemAlloc(batch.capacity * 3 * sizeof(float));
+        batch.mesh.colors = (unsigned char*)MemAlloc(batch.capacity * 4 * sizeof(unsigned char));
+    }
+    
+    int v = 0;
+    auto emit = [&](Vector3 p) {
+        batch.mesh.vertices[v * 3 + 0] = p.x;
+        batch.mesh.vertices[v * 3 + 1] = p.y;
+        batch.mesh.vertices[v * 3 + 2] = p.z;
+        v++;
+    };
+    for (size_t w = 0; w < module.walls.size(); w++) {
+        if (batch.wallFirstVertex[w] < 0) continue;
+        const std::vector<int>& idx = module.walls[w].nodeIndices;
+        for (size_t i = 1; i < idx.size() - 1; i++) {
+            Vector3 p1 = NodePosition(module.nodes, idx[0]);
+            Vector3 p2 = NodePosition(module.nodes, idx[i]);
+            Vector3 p3 = NodePosition(module.nodes, idx[i + 1]);
+            emit(p1); emit(p2); emit(p3);
+            emit(p3); emit(p2); emit(p1);
         }
+        Color color = ((int)w == batch.highlightedWall) ? batch.highlightColor : batch.wallColor;
+        SetBatchWallColor(batch, batch.wallFirstVertex[w], BatchWallVertexCount(module.walls[w]), color);
     }
     
-    Wall newWall;
-    newWall.nodeIndices = selected;
-    newWall.hasTexture = false;
-    newWall.texture = {}; // Initialize empty texture
-    module.walls.push_back(newWall);
+    if (reupload) {
+        batch.mesh.vertexCount = batch.capacity;
+        batch.mesh.triangleCount = batch.capacity / 3;
+        if (batch.capacity > 0) UploadMesh(&batch.mesh, true);
+    } else if (vertexCount > 0) {
+        UpdateMeshBuffer(batch.mesh, 0, batch.mesh.vertices, vertexCount * 3 * sizeof(float), 0);
+        UpdateMeshBuffer(batch.mesh, 3, batch.mesh.colors, vertexCount * 4 * sizeof(unsigned char), 0);
+    }
+    batch.mesh.vertexCount = vertexCount;
+    batch.mesh.triangleCount = vertexCount / 3;
+    batch.revision = module.revision;
 }
 
-void DeleteNode(GridModule& module, int nodeIdx) {
-    if (nodeIdx < 0 || nodeIdx >= (int)module.nodes.size()) return;
+// Recolour one wall's vertex range after the highlight moved, without touching positions
+void UpdateBatchWallColor(WallBatch& batch, const GridModule& module, int wall, Color color) {
+    if (wall < 0 || wall >= (int)batch.wallFirstVertex.size() || batch.wallFirstVertex[wall] < 0) return;
+    int first = batch.wallFirstVertex[wall];
+    int count = BatchWallVertexCount(module.walls[wall]);
+    SetBatchWallColor(batch, first, count, color);
+    UpdateMeshBuffer(batch.mesh, 3, batch.mesh.colors + first * 4, count * 4 * sizeof(unsigned char), first * 4);
+}
+
+// Draw a module's untextured walls in one call. The batch is rebuilt only when the
+// module revision changed; a hover change only re-uploads the affected colours.
+const WallBatch& DrawModuleWalls(WallBatchCache& cache, const GridModule& module, Color wallColor, int highlightedWall, Color highlightColor) {
+    WallBatch& batch = cache.batches[module.id];
+    bool colorsChanged = batch.wallColor.r != wallColor.r || batch.wallColor.g != wallColor.g ||
+                         batch.wallColor.b != wallColor.b || batch.wallColor.a != wallColor.a ||
+                         batch.highlightColor.r != highlightColor.r || batch.highlightColor.g != highlightColor.g ||
+                         batch.highlightColor.b != highlightColor.b || batch.highlightColor.a != highlightColor.a;
     
-    for (auto& node : module.nodes) {
-        node.connections.erase(std::remove(node.connections.begin(), node.connections.end(), nodeIdx), node.connections.end());
-        for (auto& conn : node.connections) {
-            if (conn > nodeIdx) conn--;
-        }
+    if (batch.revision != module.revision || colorsChanged) {
+        batch.wallColor = wallColor;
+        batch.highlightColor = highlightColor;
+        batch.highlightedWall = highlightedWall;
+        RebuildWallBatch(batch, module);
+        cache.rebuildsThisFrame++;
+    } else if (batch.highlightedWall != highlightedWall) {
+        UpdateBatchWallColor(batch, module, batch.highlightedWall, wallColor);
+        UpdateBatchWallColor(batch, module, highlightedWall, highlightColor);
+        batch.highlightedWall = highlightedWall;
     }
     
-    // Remove walls that contain this node
-    module.walls.erase(std::remove_if(module.walls.begin(), module.walls.end(),
-        [nodeIdx](const Wall& w) {
-            return std::find(w.nodeIndices.begin(), w.nodeIndices.end(), nodeIdx) != w.nodeIndices.end();
-        }), module.walls.end());
-    
-    // Update node indices in remaining walls
-    for (auto& wall : module.walls) {
-        for (auto& idx : wall.nodeIndices) {
-            if (idx > nodeIdx) idx--;
+    if (batch.mesh.vertexCount > 0) {
+        if (cache.material.maps == nullptr) cache.material = LoadMaterialDefault();
+        DrawMesh(batch.mesh, cache.material, MatrixIdentity());
+    }
+    batch.lastUsedFrame = cache.frame;
+    return batch;
+}
+
+void EndWallBatchFrame(WallBatchCache& cache) {
+    for (auto it = cache.batches.begin(); it != cache.batches.end();) {
+        if (cache.frame - it->second.lastUsedFrame > WALL_MESH_CACHE_GRACE_FRAMES) {
+            if (it->second.capacity > 0) UnloadMesh(it->second.mesh);
+            it = cache.batches.erase(it);
+        } else {
+            ++it;
         }
     }
-    
-    module.nodes.erase(module.nodes.begin() + nodeIdx);
+    cache.frame++;
+    cache.rebuildsThisFrame = 0;
 }
 
-void SaveState(std::deque<AppState>& history, const std::vector<GridModule>& modules, int nextModuleId, size_t maxHistory = 50) {
-    AppState state;
-    state.modules = modules;
-    state.nextModuleId = nextModuleId;
-    history.push_back(state);
-    if (history.size() > maxHistory) history.pop_front();
+void UnloadWallBatchCache(WallBatchCache& cache) {
+    for (auto& batch : cache.batches) {
+        if (batch.second.capacity > 0) UnloadMesh(batch.second.mesh);
+    }
+    cache.batches.clear();
+    MemFree(cache.material.maps);
+    cache.material = {};
 }
 
-bool RestoreState(std::deque<AppState>& history, std::vector<GridModule>& modules, int& nextModuleId) {
-    if (history.size() <= 1) return false;
-    history.pop_back();
-    if (!history.empty()) {
-        const AppState& prevState = history.back();
-        modules = prevState.modules;
-        nextModuleId = prevState.nextModuleId;
-        return true;
+// One node sphere instance: centre, radius and colour, streamed to the GPU every frame
+struct NodeInstance {
+    Vector3 position;
+    float radius;
+    Color color;
+};
+
+// Node detail levels, finest first. A node uses the first level whose minimum
+// projected radius (in pixels) it reaches; the last level is a camera-facing disc.
+struct NodeLODLevel {
+    int rings;  // 0 for the billboard disc
+    int slices; // Sides of the disc for the billboard
+    float minPixels;
+};
+
+static const NodeLODLevel NODE_LOD_LEVELS[] = {
+    {16, 16, 12.0f},
+    {8, 8, 5.0f},
+    {4, 6, 2.0f},
+    {0, 6, 0.0f},
+};
+static const int NODE_LOD_COUNT = sizeof(NODE_LOD_LEVELS) / sizeof(NODE_LOD_LEVELS[0]);
+
+// Modules whose bounds project smaller than this radius draw one proxy box instead of their nodes
+static const float MODULE_PROXY_PIXELS = 8.0f;
+
+int SelectNodeLOD(float pixelRadius) {
+    for (int level = 0; level < NODE_LOD_COUNT - 1; level++) {
+        if (pixelRadius >= NODE_LOD_LEVELS[level].minPixels) return level;
     }
-    return false;
+    return NODE_LOD_COUNT - 1;
 }
 
-// Function to draw a wall with optional texture
-void DrawWall(const Wall& wall, const std::vector<Node>& nodes, Color defaultColor, bool useTexture = false) {
-    if (wall.nodeIndices.size() < 3) return;
-    
-    if (useTexture && wall.hasTexture) {
-        // Create mesh for textured rendering
-        std::vector<Vector3> vertices;
-        for (int idx : wall.nodeIndices) {
-            if (idx >= 0 && idx < (int)nodes.size()) {
-                vertices.push_back(nodes[idx].position);
-            }
-        }
-        
-        if (vertices.size() >= 3) {
-            // Create mesh from vertices
-            Mesh mesh = {0};
-            int triangleCount = (int)vertices.size() - 2;
-            int vertexCount = triangleCount * 3;
-            
-            mesh.triangleCount = triangleCount;
-            mesh.vertexCount = vertexCount;
-            
-            mesh.vertices = (float*)MemAlloc(vertexCount * 3 * sizeof(float));
-            mesh.texcoords = (float*)MemAlloc(vertexCount * 2 * sizeof(float));
-            mesh.normals = (float*)MemAlloc(vertexCount * 3 * sizeof(float));
-            
-            // Calculate normal
-            Vector3 v1 = vertices[0];
-            Vector3 v2 = vertices[1];
-            Vector3 v3 = vertices[2];
-            Vector3 normal = Vector3Normalize(Vector3CrossProduct(
-                Vector3Subtract(v2, v1),
-                Vector3Subtract(v3, v1)
-            ));
-            
-            // Calculate bounding box for UV mapping
-            float minX = vertices[0].x, maxX = vertices[0].x;
-            float minY = vertices[0].y, maxY = vertices[0].y;
-            float minZ = vertices[0].z, maxZ = vertices[0].z;
-            
-            for (const auto& v : vertices) {
-                minX = fmin(minX, v.x); maxX = fmax(maxX, v.x);
-                minY = fmin(minY, v.y); maxY = fmax(maxY, v.y);
-                minZ = fmin(minZ, v.z); maxZ = fmax(maxZ, v.z);
-            }
-            
-            float rangeX = maxX - minX;
-            float rangeY = maxY - minY;
-            float rangeZ = maxZ - minZ;
-            
-            int idx = 0;
-            // Create triangle fan
-            for (size_t i = 1; i < vertices.size() - 1; i++) {
-                Vector3 p1 = vertices[0];
-                Vector3 p2 = vertices[i];
-                Vector3 p3 = vertices[i + 1];
-                
-                // Vertices
-                mesh.vertices[idx * 3 + 0] = p1.x;
-                mesh.vertices[idx * 3 + 1] = p1.y;
-                mesh.vertices[idx * 3 + 2] = p1.z;
-                idx++;
-                
-                mesh.vertices[idx * 3 + 0] = p2.x;
-                mesh.vertices[idx * 3 + 1] = p2.y;
-                mesh.vertices[idx * 3 + 2] = p2.z;
-                idx++;
-                
-                mesh.vertices[idx * 3 + 0] = p3.x;
-                mesh.vertices[idx * 3 + 1] = p3.y;
-                mesh.vertices[idx * 3 + 2] = p3.z;
-                idx++;
-            }
-            
-            // UV coordinates
-            idx = 0;
-            bool useXY = (rangeX > rangeY && rangeX > rangeZ);
-            bool useYZ = (!useXY && rangeY > rangeZ);
-            
-            for (size_t i = 1; i < vertices.size() - 1; i++) {
-                if (useXY) {
-                    mesh.texcoords[(idx + 0) * 2 + 0] = (vertices[0].x - minX) / rangeX;
-                    mesh.texcoords[(idx + 0) * 2 + 1] = (vertices[0].y - minY) / rangeY;
-                    mesh.texcoords[(idx + 1) * 2 + 0] = (vertices[i].x - minX) / rangeX;
-                    mesh.texcoords[(idx + 1) * 2 + 1] = (vertices[i].y - minY) / rangeY;
-                    mesh.texcoords[(idx + 2) * 2 + 0] = (vertices[i + 1].x - minX) / rangeX;
-                    mesh.texcoords[(idx + 2) * 2 + 1] = (vertices[i + 1].y - minY) / rangeY;
-                } else if (useYZ) {
-                    mesh.texcoords[(idx + 0) * 2 + 0] = (vertices[0].y - minY) / rangeY;
-                    mesh.texcoords[(idx + 0) * 2 + 1] = (vertices[0].z - minZ) / rangeZ;
-                    mesh.texcoords[(idx + 1) * 2 + 0] = (vertices[i].y - minY) / rangeY;
-                    mesh.texcoords[(idx + 1) * 2 + 1] = (vertices[i].z - minZ) / rangeZ;
-                    mesh.texcoords[(idx + 2) * 2 + 0] = (vertices[i + 1].y - minY) / rangeY;
-                    mesh.texcoords[(idx + 2) * 2 + 1] = (vertices[i + 1].z - minZ) / rangeZ;
-                } else {
-                    mesh.texcoords[(idx + 0) * 2 + 0] = (vertices[0].x - minX) / rangeX;
-                    mesh.texcoords[(idx + 0) * 2 + 1] = (vertices[0].z - minZ) / rangeZ;
-                    mesh.texcoords[(idx + 1) * 2 + 0] = (vertices[i].x - minX) / rangeX;
-                    mesh.texcoords[(idx + 1) * 2 + 1] = (vertices[i].z - minZ) / rangeZ;
-                    mesh.texcoords[(idx + 2) * 2 + 0] = (vertices[i + 1].x - minX) / rangeX;
-                    mesh.texcoords[(idx + 2) * 2 + 1] = (vertices[i + 1].z - minZ) / rangeZ;
-                }
-                idx += 3;
-            }
-            
-            // Normals
-            for (int i = 0; i < vertexCount; i++) {
-                mesh.normals[i * 3 + 0] = normal.x;
-                mesh.normals[i * 3 + 1] = normal.y;
-                mesh.normals[i * 3 + 2] = normal.z;
-            }
-            
-            // Create back mesh with reversed winding and flipped normals BEFORE uploading
-            Mesh backMesh = {0};
-            backMesh.triangleCount = triangleCount;
-            backMesh.vertexCount = vertexCount;
-            
-            backMesh.vertices = (float*)MemAlloc(vertexCount * 3 * sizeof(float));
-            backMesh.texcoords = (float*)MemAlloc(vertexCount * 2 * sizeof(float));
-            backMesh.normals = (float*)MemAlloc(vertexCount * 3 * sizeof(float));
-            
-            // Copy and reverse vertex order (swap v1 and v3 for each triangle)
-            for (int i = 0; i < vertexCount; i += 3) {
-                // Triangle vertices: copy in reverse order
-                backMesh.vertices[(i + 0) * 3 + 0] = mesh.vertices[(i + 2) * 3 + 0];
-                backMesh.vertices[(i + 0) * 3 + 1] = mesh.vertices[(i + 2) * 3 + 1];
-                backMesh.vertices[(i + 0) * 3 + 2] = mesh.vertices[(i + 2) * 3 + 2];
-                
-                backMesh.vertices[(i + 1) * 3 + 0] = mesh.vertices[(i + 1) * 3 + 0];
-                backMesh.vertices[(i + 1) * 3 + 1] = mesh.vertices[(i + 1) * 3 + 1];
-                backMesh.vertices[(i + 1) * 3 + 2] = mesh.vertices[(i + 1) * 3 + 2];
-                
-                backMesh.vertices[(i + 2) * 3 + 0] = mesh.vertices[(i + 0) * 3 + 0];
-                backMesh.vertices[(i + 2) * 3 + 1] = mesh.vertices[(i + 0) * 3 + 1];
-                backMesh.vertices[(i + 2) * 3 + 2] = mesh.vertices[(i + 0) * 3 + 2];
-                
-                // Copy UVs in same reverse order
-                backMesh.texcoords[(i + 0) * 2 + 0] = mesh.texcoords[(i + 2) * 2 + 0];
-                backMesh.texcoords[(i + 0) * 2 + 1] = mesh.texcoords[(i + 2) * 2 + 1];
-                
-                backMesh.texcoords[(i + 1) * 2 + 0] = mesh.texcoords[(i + 1) * 2 + 0];
-                backMesh.texcoords[(i + 1) * 2 + 1] = mesh.texcoords[(i + 1) * 2 + 1];
-                
-                backMesh.texcoords[(i + 2) * 2 + 0] = mesh.texcoords[(i + 0) * 2 + 0];
-                backMesh.texcoords[(i + 2) * 2 + 1] = mesh.texcoords[(i + 0) * 2 + 1];
-                
-                // Flip normals
-                backMesh.normals[(i + 0) * 3 + 0] = -normal.x;
-                backMesh.normals[(i + 0) * 3 + 1] = -normal.y;
-                backMesh.normals[(i + 0) * 3 + 2] = -normal.z;
-                
-                backMesh.normals[(i + 1) * 3 + 0] = -normal.x;
-                backMesh.normals[(i + 1) * 3 + 1] = -normal.y;
-                backMesh.normals[(i + 1) * 3 + 2] = -normal.z;
-                
-                backMesh.normals[(i + 2) * 3 + 0] = -normal.x;
-                backMesh.normals[(i + 2) * 3 + 1] = -normal.y;
-                backMesh.normals[(i + 2) * 3 + 2] = -normal.z;
-            }
-            
-            UploadMesh(&mesh, false);
-            UploadMesh(&backMesh, false);
-            
-            // Create material with texture
-            Material mat = LoadMaterialDefault();
-            mat.maps[MATERIAL_MAP_DIFFUSE].texture = wall.texture;
-            mat.maps[MATERIAL_MAP_DIFFUSE].color = WHITE; // Ensure full opacity
-            
-            // Draw both meshes
-            DrawMesh(mesh, mat, MatrixIdentity());
-            DrawMesh(backMesh, mat, MatrixIdentity());
-            
-            // Clean up
-            UnloadMesh(mesh);
-            UnloadMesh(backMesh);
-        }
-    } else {
-        // Draw without texture (original method)
-        for (size_t i = 1; i < wall.nodeIndices.size() - 1; i++) {
-            if (wall.nodeIndices[0] >= 0 && wall.nodeIndices[0] < (int)nodes.size() &&
-                wall.nodeIndices[i] >= 0 && wall.nodeIndices[i] < (int)nodes.size() &&
-                wall.nodeIndices[i + 1] >= 0 && wall.nodeIndices[i + 1] < (int)nodes.size()) {
-                Vector3 p1 = nodes[wall.nodeIndices[0]].position;
-                Vector3 p2 = nodes[wall.nodeIndices[i]].position;
-                Vector3 p3 = nodes[wall.nodeIndices[i + 1]].position;
-                
-                DrawTriangle3D(p1, p2, p3, defaultColor);
-                DrawTriangle3D(p3, p2, p1, defaultColor);
-            }
+// Instances of one detail level, drawn with their own instance buffer over a
+// range of the shared shape buffer
+struct NodeLODBatch {
+    unsigned int vao = 0;
+    unsigned int instanceVbo = 0;
+    int firstVertex = 0;
+    int vertexCount = 0;
+    int instanceCapacity = 0;
+    std::vector<NodeInstance> instances;
+};
+
+// Draws the node spheres with one instanced call per detail level
+struct NodeRenderer {
+    Shader shader = {};
+    int mvpLoc = -1;
+    int cameraRightLoc = -1;
+    int cameraUpLoc = -1;
+    int billboardLoc = -1;
+    int instancePositionLoc = -1;
+    int instanceColorLoc = -1;
+    unsigned int shapeVbo = 0; // Every level's unit shape, one after another
+    NodeLODBatch levels[NODE_LOD_COUNT];
+    bool ready = false; // False when instancing is unavailable, nodes then fall back to DrawSphereEx
+};
+
+static const char* NODE_INSTANCE_VS = R"(#version 330
+in vec3 vertexPosition;
+in vec4 instancePosition;
+in vec4 instanceColor;
+uniform mat4 mvp;
+uniform vec3 cameraRight;
+uniform vec3 cameraUp;
+uniform float billboard;
+out vec4 fragColor;
+void main() {
+    fragColor = instanceColor;
+    vec3 offset = mix(vertexPosition, cameraRight*vertexPosition.x + cameraUp*vertexPosition.y, billboard);
+    gl_Position = mvp*vec4(instancePosition.xyz + offset*instancePosition.w, 1.0);
+}
+)";
+
+static const char* NODE_INSTANCE_FS = R"(#version 330
+in vec4 fragColor;
+out vec4 finalColor;
+void main() {
+    finalColor = fragColor;
+}
+)";
+
+// Unit sphere as a plain triangle list, same ring/slice layout as DrawSphere
+std::vector<float> GenSphereVertices(int rings, int slices) {
+    std::vector<float> vertices;
+    vertices.reserve((size_t)rings * slices * 6 * 3);
+    auto point = [](int ring, int slice, int rings, int slices) {
+        float theta = PI * (float)ring / (float)rings;          // 0 at the north pole
+        float phi = 2.0f * PI * (float)slice / (float)slices;
+        return Vector3{sinf(theta) * cosf(phi), cosf(theta), sinf(theta) * sinf(phi)};
+    };
+    auto emit = [&](Vector3 v) {
+        vertices.push_back(v.x);
+        vertices.push_back(v.y);
+        vertices.push_back(v.z);
+    };
+    for (int r = 0; r < rings; r++) {
+        for (int s = 0; s < slices; s++) {
+            Vector3 a = point(r, s, rings, slices);
+            Vector3 b = point(r + 1, s, rings, slices);
+            Vector3 c = point(r + 1, s + 1, rings, slices);
+            Vector3 d = point(r, s + 1, rings, slices);
+            // Counter-clockwise seen from outside
+            emit(a); emit(c); emit(b);
+            emit(a); emit(d); emit(c);
         }
     }
+    return vertices;
 }
 
-bool ExportToOBJ(const std::vector<GridModule>& modules, const char* filename) {
-    std::ofstream file(filename);
-    if (!file.is_open()) {
-        return false;
+// Unit disc in the xy plane as a triangle list, counter-clockwise seen from +z
+std::vector<float> GenDiscVertices(int sides) {
+    std::vector<float> vertices;
+    vertices.reserve((size_t)sides * 3 * 3);
+    for (int s = 0; s < sides; s++) {
+        float a0 = 2.0f * PI * (float)s / (float)sides;
+        float a1 = 2.0f * PI * (float)(s + 1) / (float)sides;
+        const float triangle[9] = {0.0f, 0.0f, 0.0f, cosf(a0), sinf(a0), 0.0f, cosf(a1), sinf(a1), 0.0f};
+        vertices.insert(vertices.end(), triangle, triangle + 9);
     }
+    return vertices;
+}
+
+void BindNodeInstanceAttributes(NodeRenderer& renderer, const NodeLODBatch& batch) {
+    rlEnableVertexBuffer(batch.instanceVbo);
+    rlSetVertexAttribute(renderer.instancePositionLoc, 4, RL_FLOAT, false, sizeof(NodeInstance), 0);
+    rlEnableVertexAttribute(renderer.instancePositionLoc);
+    rlSetVertexAttributeDivisor(renderer.instancePositionLoc, 1);
+    rlSetVertexAttribute(renderer.instanceColorLoc, 4, RL_UNSIGNED_BYTE, true, sizeof(NodeInstance), offsetof(NodeInstance, color));
+    rlEnableVertexAttribute(renderer.instanceColorLoc);
+    rlSetVertexAttributeDivisor(renderer.instanceColorLoc, 1);
+    rlDisableVertexBuffer();
+}
+
+void LoadNodeRenderer(NodeRenderer& renderer) {
+    renderer.shader = LoadShaderFromMemory(NODE_INSTANCE_VS, NODE_INSTANCE_FS);
+    if (!IsShaderValid(renderer.shader)) {
+        printf("Instanced node shader unavailable, drawing nodes one by one\n");
+        return;
+    }
+    renderer.mvpLoc = GetShaderLocation(renderer.shader, "mvp");
+    renderer.cameraRightLoc = GetShaderLocation(renderer.shader, "cameraRight");
+    renderer.cameraUpLoc = GetShaderLocation(renderer.shader, "cameraUp");
+    renderer.billboardLoc = GetShaderLocation(renderer.shader, "billboard");
+    renderer.instancePositionLoc = GetShaderLocationAttrib(renderer.shader, "instancePosition");
+    renderer.instanceColorLoc = GetShaderLocationAttrib(renderer.shader, "instanceColor");
+    int vertexLoc = GetShaderLocationAttrib(renderer.shader, "vertexPosition");
     
-    // Write header
-    file << "# OBJ file exported from GreyScaleCube\n";
-    file << "# Generated model\n\n";
-    
-    // Count total vertices first to get proper indices
-    int vertexOffset = 1; // OBJ indices start at 1
+    std::vector<float> shapes;
+    for (int level = 0; level < NODE_LOD_COUNT; level++) {
+        const NodeLODLevel& lod = NODE_LOD_LEVELS[level];
+        std::vector<float> shape = lod.rings > 0 ? GenSphereVertices(lod.rings, lod.slices) : GenDiscVertices(lod.slices);
+        renderer.levels[level].firstVertex = (int)shapes.size() / 3;
+        renderer.levels[level].vertexCount = (int)shape.size() / 3;
+        shapes.insert(shapes.end(), shape.begin(), shape.end());
+    }
+    renderer.shapeVbo = rlLoadVertexBuffer(shapes.data(), (int)(shapes.size() * sizeof(float)), false);
     
-    // Export all vertices (nodes/spheres)
-    for (size_t m = 0; m < modules.size(); m++) {
-        file << "# Module " << modules[m].id << "\n";
-        for (const auto& node : modules[m].nodes) {
-            file << "v " << node.position.x << " " << node.position.y << " " << node.position.z << "\n";
+    for (NodeLODBatch& batch : renderer.levels) {
+        batch.instanceCapacity = 1024;
+        batch.vao = rlLoadVertexArray();
+        rlEnableVertexArray(batch.vao);
+        rlEnableVertexBuffer(renderer.shapeVbo);
+        rlSetVertexAttribute(vertexLoc, 3, RL_FLOAT, false, 0, 0);
+        rlEnableVertexAttribute(vertexLoc);
+        batch.instanceVbo = rlLoadVertexBuffer(nullptr, batch.instanceCapacity * (int)sizeof(NodeInstance), true);
+        BindNodeInstanceAttributes(renderer, batch);
+        rlDisableVertexArray();
+    }
+    renderer.ready = true;
+}
+
+void UnloadNodeRenderer(NodeRenderer& renderer) {
+    if (!renderer.ready) return;
+    for (NodeLODBatch& batch : renderer.levels) {
+        rlUnloadVertexBuffer(batch.instanceVbo);
+        rlUnloadVertexArray(batch.vao);
+    }
+    rlUnloadVertexBuffer(renderer.shapeVbo);
+    UnloadShader(renderer.shader);
+    renderer.ready = false;
+}
+
+void AddNodeInstance(NodeRenderer& renderer, int level, Vector3 position, float radius, Color color) {
+    renderer.levels[level].instances.push_back({position, radius, color});
+}
+
+// Upload this frame's instances and draw each detail level in one call, then clear the lists
+void DrawNodeInstances(NodeRenderer& renderer) {
+    if (!renderer.ready) {
+        for (int level = 0; level < NODE_LOD_COUNT; level++) {
+            const NodeLODLevel& lod = NODE_LOD_LEVELS[level];
+            for (const auto& inst : renderer.levels[level].instances) {
+                DrawSphereEx(inst.position, inst.radius, std::max(lod.rings, 2), lod.slices, inst.color);
+            }
+            renderer.levels[level].instances.clear();
         }
+        return;
     }
     
-    file << "\n# Connections (lines)\n";
+    // Flush raylib's immediate-mode batch so lines and walls keep their draw order
+    rlDrawRenderBatchActive();
+    Matrix view = rlGetMatrixModelview();
+    Vector3 cameraRight = {view.m0, view.m4, view.m8};
+    Vector3 cameraUp = {view.m1, view.m5, view.m9};
+    rlEnableShader(renderer.shader.id);
+    rlSetUniformMatrix(renderer.mvpLoc, MatrixMultiply(view, rlGetMatrixProjection()));
+    rlSetUniform(renderer.cameraRightLoc, &cameraRight, SHADER_UNIFORM_VEC3, 1);
+    rlSetUniform(renderer.cameraUpLoc, &cameraUp, SHADER_UNIFORM_VEC3, 1);
     
-    // Export connections as lines
-    vertexOffset = 1;
-    for (size_t m = 0; m < modules.size(); m++) {
-        for (size_t i = 0; i < modules[m].nodes.size(); i++) {
-            for (int conn : modules[m].nodes[i].connections) {
-                // Only export each connection once (when from < to)
-                if ((int)i < conn) {
-                    int v1 = vertexOffset + (int)i;
-                    int v2 = vertexOffset + conn;
-                    file << "l " << v1 << " " << v2 << "\n";
-                }
-            }
+    for (int level = 0; level < NODE_LOD_COUNT; level++) {
+        NodeLODBatch& batch = renderer.levels[level];
+        int count = (int)batch.instances.size();
+        if (count == 0) continue;
+        
+        if (count > batch.instanceCapacity) {
+            while (batch.instanceCapacity < count) batch.instanceCapacity *= 2;
+            rlEnableVertexArray(batch.vao);
+            rlUnloadVertexBuffer(batch.instanceVbo);
+            batch.instanceVbo = rlLoadVertexBuffer(nullptr, batch.instanceCapacity * (int)sizeof(NodeInstance), true);
+            BindNodeInstanceAttributes(renderer, batch);
+            rlDisableVertexArray();
         }
-        vertexOffset += (int)modules[m].nodes.size();
+        rlUpdateVertexBuffer(batch.instanceVbo, batch.instances.data(), count * (int)sizeof(NodeInstance), 0);
+        
+        float billboard = NODE_LOD_LEVELS[level].rings == 0 ? 1.0f : 0.0f;
+        rlSetUniform(renderer.billboardLoc, &billboard, SHADER_UNIFORM_FLOAT, 1);
+        rlEnableVertexArray(batch.vao);
+        rlDrawVertexArrayInstanced(batch.firstVertex, batch.vertexCount, count);
+        rlDisableVertexArray();
+        batch.instances.clear();
     }
+    rlDisableShader();
+}
+
+// Stacked per-phase frame times for the recent frames, newest on the right, with
+// lines at 60 and 30 FPS and the phase averages over the last second
+void DrawProfilerGraph(const Profiler& profiler, int x, int y, int width, int height) {
+    static const Color phaseColors[PHASE_COUNT] = {
+        SKYBLUE, GREEN, LIME, ORANGE, Color{100, 100, 150, 255}, GRAY, PURPLE, YELLOW
+    };
+    const float maxMs = 40.0f;
+    int legendHeight = 16 * ((PHASE_COUNT + 1) / 2);
     
-    file << "\n# Walls (faces)\n";
-    
-    // Export walls as faces
-    vertexOffset = 1;
-    for (size_t m = 0; m < modules.size(); m++) {
-        for (const auto& wall : modules[m].walls) {
-            if (wall.nodeIndices.size() >= 3) {
-                file << "f";
-                for (int nodeIdx : wall.nodeIndices) {
-                    file << " " << (vertexOffset + nodeIdx);
-                }
-                file << "\n";
-            }
+    DrawRectangle(x, y, width, height + legendHeight + 8, Color{0, 0, 0, 180});
+    float barWidth = (float)width / PROFILE_HISTORY_FRAMES;
+    for (int i = 0; i < profiler.historyCount; i++) {
+        int row = (profiler.historyHead - profiler.historyCount + i + PROFILE_HISTORY_FRAMES) % PROFILE_HISTORY_FRAMES;
+        float barX = x + width - (profiler.historyCount - i) * barWidth;
+        float top = (float)(y + height);
+        for (int p = 0; p < PHASE_COUNT; p++) {
+            float h = profiler.historyMs[row][p] / maxMs * height;
+            if (top - h < y) h = top - y;
+            if (h <= 0.0f) continue;
+            top -= h;
+            DrawRectangleRec({barX, top, barWidth, h}, phaseColors[p]);
         }
-        vertexOffset += (int)modules[m].nodes.size();
     }
     
-    file.close();
-    return true;
+    for (float ms : {1000.0f / 60.0f, 1000.0f / 30.0f}) {
+        int lineY = y + height - (int)(ms / maxMs * height);
+        DrawLine(x, lineY, x + width, lineY, Color{255, 255, 255, 90});
+        DrawText(TextFormat("%.1f ms", ms), x + 4, lineY - 12, 10, LIGHTGRAY);
+    }
+    
+    for (int p = 0; p < PHASE_COUNT; p++) {
+        int legendX = x + 8 + (p % 2) * (width / 2);
+        int legendY = y + height + 6 + (p / 2) * 16;
+        DrawRectangle(legendX, legendY + 2, 10, 10, phaseColors[p]);
+        DrawText(TextFormat("%s %.2f ms", ProfilePhaseName(p), AverageProfilePhaseMs(profiler, p, 60)), legendX + 16, legendY, 14, LIGHTGRAY);
+    }
 }
 
 int main() {
@@ -566,14 +675,34 @@ int main() {
     
     std::vector<GridModule> modules;
     int nextModuleId = 0;
-    std::deque<AppState> undoHistory;
+    EditJournal journal;
+    SceneGraph graph; // Connections between modules
+    ScenePickBVH scenePick;
+    WallMeshCache wallMeshes;
+    WallBatchCache wallBatches;
+    NodeRenderer nodeRenderer;
+    LoadNodeRenderer(nodeRenderer);
+    ObjExporter objExporter;
+    TextureCache textures;
+    Profiler profiler;
+    InitProfiler(profiler);
+    bool showProfiler = false;
+    
+    // Reopen the last saved project, or start from a single grid
+    const char* projectFile = "project.gscp";
+    if (FileExists(projectFile) && LoadProject(projectFile, modules, graph, nextModuleId, textures)) {
+        printf("Project loaded from %s\n", projectFile);
+    } else {
+        GridModule initialModule;
+        initialModule.nodes = CreateImplicitGrid({0.0f, 5.0f, 0.0f}, gridTotalSize, gridSize);
+        initialModule.center = {0.0f, 5.0f, 0.0f};
+        initialModule.id = nextModuleId++;
+        modules.push_back(initialModule);
+    }
     
-    GridModule initialModule;
-    initialModule.nodes = Create3DGridStructure({0.0f, 5.0f, 0.0f}, gridTotalSize, gridSize);
-    initialModule.center = {0.0f, 5.0f, 0.0f};
-    initialModule.id = nextModuleId++;
-    modules.push_back(initialModule);
-    SaveState(undoHistory, modules, nextModuleId);
+    // Modules far from the camera are paged out next to the project file once the scene outgrows the budget
+    ScenePager pager;
+    pager.pathPrefix = std::string(projectFile) + ".page";
 
     Camera3D camera{};
     camera.position = {25.0f, 20.0f, 25.0f};
@@ -590,6 +719,7 @@ int main() {
     int hoveredNode = -1, hoveredModule = -1, hoveredWall = -1;
     float dragDistance = 0.0f;
     Vector3 lastMouseWorld = {0.0f, 0.0f, 0.0f};
+    Vector3 dragStartPosition = {0.0f, 0.0f, 0.0f}; // Node position or module center when a drag began
     int gridSlices = 20;
     
     // Mode system
@@ -597,7 +727,7 @@ int main() {
     Mode currentMode = MODE_SELECT;
     
     // Select & Fill mode variables
-    std::vector<int> selectedNodes;
+    std::vector<NodeHandle> selectedNodes; // Handles, so a deleted node drops out of the selection
     int selectedModule = -1;
     int activeModule = -1;
     
@@ -609,8 +739,15 @@ int main() {
     // Connect mode variables
     int connectStartNode = -1;
     int connectStartModule = -1;
+    
+    std::vector<char> selectedFlags; // Scratch for node colouring
+    std::vector<unsigned char> moduleVisibility; // FrustumTest of each module this frame
+    std::vector<char> moduleProxy;               // Module too small on screen to draw node by node
+    std::vector<char> visibleWalls;              // Scratch for culling textured walls
 
     while (!WindowShouldClose()) {
+        ProfileScope inputScope(profiler, PHASE_INPUT);
+        
         if (IsKeyPressed(KEY_TAB)) {
             cursorEnabled = !cursorEnabled;
             cursorEnabled ? EnableCursor() : DisableCursor();
@@ -618,6 +755,17 @@ int main() {
         
         if (IsKeyPressed(KEY_G)) showGrid = !showGrid;
         if (IsKeyPressed(KEY_C)) showConnections = !showConnections;
+        if (IsKeyPressed(KEY_F3)) showProfiler = !showProfiler;
+        
+        // Dump the recent frame phases as a Chrome trace (F4)
+        if (IsKeyPressed(KEY_F4)) {
+            const char* traceFile = "profile.json";
+            if (WriteChromeTrace(profiler, traceFile)) {
+                printf("Profile written to %s\n", traceFile);
+            } else {
+                printf("Failed to write profile to %s\n", traceFile);
+            }
+        }
         
         // Mode switching
         if (cursorEnabled && IsKeyPressed(KEY_ONE)) {
@@ -667,8 +815,16 @@ int main() {
         }
         
         if (currentMode == MODE_SELECT && IsKeyPressed(KEY_SPACE) && selectedNodes.size() >= 3 && selectedModule != -1) {
-            CreateWallFromSelectedNodes(modules[selectedModule], selectedNodes);
-            SaveState(undoHistory, modules, nextModuleId);
+            std::vector<int> selectedSlots;
+            for (NodeHandle handle : selectedNodes) {
+                int slot = ResolveNodeHandle(modules[selectedModule].nodes, handle);
+                if (slot != -1) selectedSlots.push_back(slot);
+            }
+            if (CreateWallFromSelectedNodes(modules[selectedModule], selectedSlots)) {
+                EditCommand cmd = MakeEdit(EDIT_CREATE_WALL, modules[selectedModule].id);
+                cmd.wall = (int)modules[selectedModule].walls.size() - 1;
+                RecordEdit(journal, std::move(cmd));
+            }
             selectedNodes.clear();
             selectedModule = -1;
         }
@@ -676,44 +832,113 @@ int main() {
         if (IsKeyPressed(KEY_N)) {
             GridModule newModule;
             Vector3 newCenter = Vector3Add(modules.back().center, {15.0f, 0.0f, 0.0f});
-            newModule.nodes = Create3DGridStructure(newCenter, gridTotalSize, gridSize);
+            newModule.nodes = CreateImplicitGrid(newCenter, gridTotalSize, gridSize);
             newModule.center = newCenter;
-            newModule.id = nextModuleId++;
-            modules.push_back(newModule);
-            SaveState(undoHistory, modules, nextModuleId);
+            newModule.id = nextModuleId;
+            
+            EditCommand cmd = MakeEdit(EDIT_ADD_MODULE, newModule.id);
+            cmd.module.reset(new GridModule(std::move(newModule)));
+            cmd.nextModuleIdBefore = nextModuleId;
+            cmd.nextModuleIdAfter = nextModuleId + 1;
+            PerformEdit(journal, modules, graph, nextModuleId, std::move(cmd));
         }
         
         // Export to OBJ file (Ctrl+S or F5)
-        if ((IsKeyDown(KEY_LEFT_CONTROL) || IsKeyDown(KEY_RIGHT_CONTROL)) && IsKeyPressed(KEY_S)) {
-            const char* filename = "model.obj";
-            if (ExportToOBJ(modules, filename)) {
+        if (((IsKeyDown(KEY_LEFT_CONTROL) || IsKeyDown(KEY_RIGHT_CONTROL)) && IsKeyPressed(KEY_S)) || IsKeyPressed(KEY_F5)) {
+            // Saving is a natural point to close the gaps left by deleted nodes
+            // Paged modules stay as they are; compacting would copy their page back into memory
+            for (auto& module : modules) {
+                if (!module.paged) CompactModuleNodes(module, graph, journal);
+            }
+            hoveredNode = -1;
+            selectedNodes.clear();
+            selectedModule = -1;
+            connectStartNode = connectStartModule = -1;
+            isDragging = false;
+            
+            // Written on a background thread from a snapshot, so editing carries on meanwhile
+            if (StartObjExport(objExporter, modules, graph, "model.obj")) {
+                printf("Exporting model to %s\n", objExporter.filename.c_str());
+            } else {
+                printf("Export to %s still in progress\n", objExporter.filename.c_str());
+            }
+        }
+        if (PollObjExport(objExporter)) {
+            if (objExporter.succeeded) {
                 // Show success message (you could add a message system here)
-                printf("Model exported to %s\n", filename);
+                printf("Model exported to %s\n", objExporter.filename.c_str());
             } else {
-                printf("Failed to export model to %s\n", filename);
+                printf("Failed to export model to %s\n", objExporter.filename.c_str());
             }
         }
         
-        if (IsKeyPressed(KEY_F5)) {
-            // Alternative: F5 to save
-            const char* filename = "model.obj";
-            if (ExportToOBJ(modules, filename)) {
+        // Export walls to glTF binary (F7)
+        if (IsKeyPressed(KEY_F7)) {
+            const char* filename = "model.glb";
+            if (ExportToGLB(modules, filename)) {
                 printf("Model exported to %s\n", filename);
             } else {
                 printf("Failed to export model to %s\n", filename);
             }
         }
         
-        if (((IsKeyDown(KEY_LEFT_CONTROL) || IsKeyDown(KEY_RIGHT_CONTROL)) && IsKeyPressed(KEY_Z)) || IsKeyPressed(KEY_BACKSPACE)) {
-            if (RestoreState(undoHistory, modules, nextModuleId)) {
+        // Save the project (F6)
+        if (IsKeyPressed(KEY_F6)) {
+            if (SaveProject(modules, graph, nextModuleId, projectFile)) {
+                printf("Project saved to %s\n", projectFile);
+            } else {
+                printf("Failed to save project to %s\n", projectFile);
+            }
+        }
+        // Reopen the saved project (F9) or import model.obj (Ctrl+O), replacing the scene
+        bool openProject = IsKeyPressed(KEY_F9);
+        bool importModel = (IsKeyDown(KEY_LEFT_CONTROL) || IsKeyDown(KEY_RIGHT_CONTROL)) && IsKeyPressed(KEY_O);
+        if (importModel && objExporter.running) {
+            printf("Export to %s still in progress\n", objExporter.filename.c_str());
+            importModel = false;
+        }
+        if (openProject || importModel) {
+            const char* source = openProject ? projectFile : "model.obj";
+            std::vector<GridModule> loadedModules;
+            SceneGraph loadedGraph;
+            int loadedNextId = 0;
+            bool loaded = openProject ? LoadProject(source, loadedModules, loadedGraph, loadedNextId, textures)
+                                      : ImportOBJ(source, loadedModules, loadedGraph, loadedNextId);
+            if (loaded) {
+                ClearJournal(journal);
+                modules = std::move(loadedModules);
+                graph = std::move(loadedGraph);
+                nextModuleId = loadedNextId;
                 hoveredNode = hoveredModule = hoveredWall = -1;
                 isDragging = isDraggingModule = false;
                 selectedNodes.clear();
                 selectedModule = -1;
                 activeModule = -1;
+                connectStartNode = connectStartModule = -1;
+                printf("Loaded %s\n", source);
+            } else {
+                printf("Failed to load %s\n", source);
             }
         }
         
+        inputScope.End();
+        
+        ProfileScope undoScope(profiler, PHASE_UNDO);
+        bool ctrlDown = IsKeyDown(KEY_LEFT_CONTROL) || IsKeyDown(KEY_RIGHT_CONTROL);
+        bool shiftDown = IsKeyDown(KEY_LEFT_SHIFT) || IsKeyDown(KEY_RIGHT_SHIFT);
+        bool undoPressed = (ctrlDown && !shiftDown && IsKeyPressed(KEY_Z)) || IsKeyPressed(KEY_BACKSPACE);
+        bool redoPressed = ctrlDown && (IsKeyPressed(KEY_Y) || (shiftDown && IsKeyPressed(KEY_Z)));
+        if ((undoPressed && UndoEdit(journal, modules, graph, nextModuleId)) ||
+            (redoPressed && RedoEdit(journal, modules, graph, nextModuleId))) {
+            hoveredNode = hoveredModule = hoveredWall = -1;
+            isDragging = isDraggingModule = false;
+            selectedNodes.clear();
+            selectedModule = -1;
+            activeModule = -1;
+        }
+        undoScope.End();
+        
+        ProfileScope movementScope(profiler, PHASE_INPUT); // Keyboard module moves and the camera
         if (cursorEnabled && activeModule != -1 && activeModule < (int)modules.size()) {
             float moveSpeed = 0.5f;
             Vector3 movement = {0, 0, 0};
@@ -745,11 +970,9 @@ int main() {
             }
             
             if (moved) {
-                for (auto& node : modules[activeModule].nodes) {
-                    node.position = Vector3Add(node.position, movement);
-                }
-                modules[activeModule].center = Vector3Add(modules[activeModule].center, movement);
-                SaveState(undoHistory, modules, nextModuleId);
+                EditCommand cmd = MakeEdit(EDIT_MOVE_MODULE, modules[activeModule].id);
+                cmd.to = movement;
+                PerformEdit(journal, modules, graph, nextModuleId, std::move(cmd));
             }
         }
 
@@ -806,10 +1029,14 @@ int main() {
             }
         }
         
+        movementScope.End();
+        
         if (cursorEnabled) {
             // Always update hover detection for all modes (even during camera rotation)
             if (!isDragging && !isDraggingModule) {
-                hoveredModule = GetModuleUnderMouse(modules, camera, sphereRadius * 1.5f);
+                ProfileScope hoverScope(profiler, PHASE_HOVER);
+                UpdateScenePicking(modules, scenePick);
+                hoveredModule = GetModuleUnderMouse(modules, scenePick, camera, sphereRadius * 1.5f);
                 hoveredNode = hoveredWall = -1;
                 
                 if (hoveredModule != -1) {
@@ -822,6 +1049,8 @@ int main() {
                 }
             }
             
+            ProfileScope modeScope(profiler, PHASE_MODE);
+            
             // Update preview position for add node mode
             if (currentMode == MODE_ADD_NODE) {
                 previewNodePosition = GetMouseWorldPosition(camera, addNodeDistance);
@@ -835,44 +1064,27 @@ int main() {
                 }
             }
             
-            if (IsKeyPressed(KEY_DELETE)) {
-                bool changed = false;
-                if (hoveredWall != -1 && hoveredModule != -1) {
-                    modules[hoveredModule].walls.erase(modules[hoveredModule].walls.begin() + hoveredWall);
-                    hoveredWall = -1; changed = true;
-                } else if (hoveredNode != -1 && hoveredModule != -1) {
-                    DeleteNode(modules[hoveredModule], hoveredNode);
-                    hoveredNode = -1; changed = true;
-                } else if (hoveredModule != -1 && modules.size() > 1) {
-                    modules.erase(modules.begin() + hoveredModule);
-                    hoveredModule = -1; changed = true;
-                }
-                if (changed) SaveState(undoHistory, modules, nextModuleId);
-            }
-            
-            if (IsKeyPressed(KEY_DELETE)) {
-                bool changed = false;
-                if (hoveredWall != -1 && hoveredModule != -1) {
-                    // Unload texture if it exists
-                    if (modules[hoveredModule].walls[hoveredWall].hasTexture) {
-                        UnloadTexture(modules[hoveredModule].walls[hoveredWall].texture);
+            if (IsKeyPressed(KEY_DELETE) && hoveredModule != -1) {
+                // Textures of deleted walls stay loaded while the journal can still restore them
+                int moduleId = modules[hoveredModule].id;
+                if (hoveredWall != -1) {
+                    EditCommand cmd = MakeEdit(EDIT_DELETE_WALL, moduleId);
+                    cmd.wall = hoveredWall;
+                    PerformEdit(journal, modules, graph, nextModuleId, std::move(cmd));
+                    hoveredWall = -1;
+                } else if (hoveredNode != -1) {
+                    EditCommand cmd = MakeEdit(EDIT_DELETE_NODE, moduleId);
+                    cmd.node = hoveredNode;
+                    PerformEdit(journal, modules, graph, nextModuleId, std::move(cmd));
+                    if (connectStartModule == hoveredModule && connectStartNode == hoveredNode) {
+                        connectStartNode = connectStartModule = -1;
                     }
-                    modules[hoveredModule].walls.erase(modules[hoveredModule].walls.begin() + hoveredWall);
-                    hoveredWall = -1; changed = true;
-                } else if (hoveredNode != -1 && hoveredModule != -1) {
-                    DeleteNode(modules[hoveredModule], hoveredNode);
-                    hoveredNode = -1; changed = true;
-                } else if (hoveredModule != -1 && modules.size() > 1) {
-                    // Unload all textures in module before deleting
-                    for (auto& wall : modules[hoveredModule].walls) {
-                        if (wall.hasTexture) {
-                            UnloadTexture(wall.texture);
-                        }
-                    }
-                    modules.erase(modules.begin() + hoveredModule);
-                    hoveredModule = -1; changed = true;
+                    hoveredNode = -1;
+                } else if (modules.size() > 1) {
+                    PerformEdit(journal, modules, graph, nextModuleId, MakeEdit(EDIT_DELETE_MODULE, moduleId));
+                    hoveredModule = -1;
+                    if (activeModule >= (int)modules.size()) activeModule = -1;
                 }
-                if (changed) SaveState(undoHistory, modules, nextModuleId);
             }
             
             // Load texture on wall (T key) - works when hovering over a wall
@@ -880,43 +1092,30 @@ int main() {
                 if (hoveredWall != -1 && hoveredModule != -1) {
                     printf("Attempting to load texture on wall %d in module %d\n", hoveredWall, hoveredModule);
                     
-                    // Try to load texture from file - check common names
+                    // Try to load texture from file - check common names. The file is decoded in
+                    // the background and the wall shows a placeholder until it is uploaded; files
+                    // already loaded for other walls come from the texture cache.
                     const char* texturePaths[] = {"texture.png", "texture.jpg", "wall.png", "wall.jpg", "tex.png", "tex.jpg"};
-                    bool loaded = false;
+                    std::shared_ptr<TextureAsset> tex;
                     
                     for (int i = 0; i < 6; i++) {
                         if (FileExists(texturePaths[i])) {
                             printf("Found texture file: %s\n", texturePaths[i]);
-                            Texture2D tex = LoadTexture(texturePaths[i]);
-                            if (tex.id != 0) {
-                                if (modules[hoveredModule].walls[hoveredWall].hasTexture) {
-                                    UnloadTexture(modules[hoveredModule].walls[hoveredWall].texture);
-                                }
-                                modules[hoveredModule].walls[hoveredWall].texture = tex;
-                                modules[hoveredModule].walls[hoveredWall].hasTexture = true;
-                                printf("Successfully loaded texture: %s\n", texturePaths[i]);
-                                loaded = true;
-                                break;
-                            } else {
-                                printf("Failed to load texture from file: %s\n", texturePaths[i]);
-                            }
+                            tex = RequestTexture(textures, texturePaths[i]);
+                            break;
                         }
                     }
                     
-                    if (!loaded) {
-                        printf("No texture file found, creating default blue texture\n");
-                        // Create a simple colored texture as fallback
-                        Image img = GenImageColor(256, 256, BLUE);
-                        Texture2D tex = LoadTextureFromImage(img);
-                        UnloadImage(img);
-                        
-                        if (modules[hoveredModule].walls[hoveredWall].hasTexture) {
-                            UnloadTexture(modules[hoveredModule].walls[hoveredWall].texture);
-                        }
-                        modules[hoveredModule].walls[hoveredWall].texture = tex;
-                        modules[hoveredModule].walls[hoveredWall].hasTexture = true;
-                        printf("Created default blue texture for wall (place texture.png in directory)\n");
+                    if (!tex) {
+                        printf("No texture file found, using default blue texture (place texture.png in directory)\n");
+                        tex = AcquireSolidTexture(textures, BLUE, 256, 256);
                     }
+                    
+                    // The previous texture stays with the journal entry so the change can be undone
+                    EditCommand cmd = MakeEdit(EDIT_SET_TEXTURE, modules[hoveredModule].id);
+                    cmd.wall = hoveredWall;
+                    cmd.newTexture = tex;
+                    PerformEdit(journal, modules, graph, nextModuleId, std::move(cmd));
                 } else {
                     printf("T key pressed but no wall hovered! Hover over a wall first.\n");
                     printf("  hoveredWall=%d, hoveredModule=%d\n", hoveredWall, hoveredModule);
@@ -932,11 +1131,12 @@ int main() {
                     }
                     
                     if (selectedModule == hoveredModule) {
-                        auto it = std::find(selectedNodes.begin(), selectedNodes.end(), hoveredNode);
+                        auto it = std::find_if(selectedNodes.begin(), selectedNodes.end(),
+                            [&](NodeHandle h) { return ResolveNodeHandle(modules[hoveredModule].nodes, h) == hoveredNode; });
                         if (it != selectedNodes.end()) {
                             selectedNodes.erase(it);
                         } else {
-                            selectedNodes.push_back(hoveredNode); // No limit on selection
+                            selectedNodes.push_back(GetNodeHandle(modules[hoveredModule].nodes, hoveredNode)); // No limit on selection
                         }
                     }
                 }
@@ -952,16 +1152,22 @@ int main() {
                 if (IsMouseButtonPressed(MOUSE_LEFT_BUTTON) && hoveredNode != -1 && hoveredModule != -1) {
                     isDragging = true;
                     activeModule = hoveredModule;
-                    dragDistance = Vector3Distance(camera.position, modules[hoveredModule].nodes[hoveredNode].position);
+                    dragStartPosition = NodePosition(modules[hoveredModule].nodes, hoveredNode);
+                    dragDistance = Vector3Distance(camera.position, dragStartPosition);
                 }
                 
                 if (isDragging && hoveredNode != -1 && hoveredModule != -1) {
-                    modules[hoveredModule].nodes[hoveredNode].position = GetMouseWorldPosition(camera, dragDistance);
+                    MoveNode(modules[hoveredModule], hoveredNode, GetMouseWorldPosition(camera, dragDistance));
                 }
                 
                 if (IsMouseButtonReleased(MOUSE_LEFT_BUTTON)) {
-                    if (isDragging) {
-                        SaveState(undoHistory, modules, nextModuleId);
+                    // The node already sits at its final position, so only record the move
+                    if (isDragging && hoveredNode != -1 && hoveredModule != -1) {
+                        EditCommand cmd = MakeEdit(EDIT_MOVE_NODE, modules[hoveredModule].id);
+                        cmd.node = hoveredNode;
+                        cmd.from = dragStartPosition;
+                        cmd.to = NodePosition(modules[hoveredModule].nodes, hoveredNode);
+                        RecordEdit(journal, std::move(cmd));
                     }
                     isDragging = false;
                 }
@@ -973,22 +1179,22 @@ int main() {
                     isDraggingModule = true;
                     activeModule = hoveredModule;
                     dragDistance = 20.0f;
+                    dragStartPosition = modules[hoveredModule].center;
                     lastMouseWorld = GetMouseWorldPosition(camera, dragDistance);
                 }
                 
                 if (isDraggingModule && hoveredModule != -1) {
                     Vector3 cur = GetMouseWorldPosition(camera, dragDistance);
                     Vector3 delta = Vector3Subtract(cur, lastMouseWorld);
-                    for (auto& node : modules[hoveredModule].nodes) {
-                        node.position = Vector3Add(node.position, delta);
-                    }
-                    modules[hoveredModule].center = Vector3Add(modules[hoveredModule].center, delta);
+                    TranslateModule(modules[hoveredModule], delta);
                     lastMouseWorld = cur;
                 }
                 
                 if (IsMouseButtonReleased(MOUSE_LEFT_BUTTON)) {
-                    if (isDraggingModule) {
-                        SaveState(undoHistory, modules, nextModuleId);
+                    if (isDraggingModule && hoveredModule != -1) {
+                        EditCommand cmd = MakeEdit(EDIT_MOVE_MODULE, modules[hoveredModule].id);
+                        cmd.to = Vector3Subtract(modules[hoveredModule].center, dragStartPosition);
+                        RecordEdit(journal, std::move(cmd));
                     }
                     isDraggingModule = false;
                 }
@@ -1004,17 +1210,8 @@ int main() {
                     
                     // First, check if the new position is close to any existing module
                     // If so, add to that module instead of creating a new one
-                    int closestModule = -1;
-                    float closestDist = FLT_MAX;
-                    for (size_t m = 0; m < modules.size(); m++) {
-                        for (size_t i = 0; i < modules[m].nodes.size(); i++) {
-                            float dist = Vector3Distance(previewNodePosition, modules[m].nodes[i].position);
-                            if (dist < closestDist && dist <= moduleAssignmentDistance) {
-                                closestDist = dist;
-                                closestModule = (int)m;
-                            }
-                        }
-                    }
+                    UpdateScenePicking(modules, scenePick);
+                    int closestModule = FindClosestModule(modules, scenePick, previewNodePosition, moduleAssignmentDistance);
                     
                     if (closestModule != -1 && hoveredModule == -1) {
                         // Add to the closest module instead of creating a new one
@@ -1023,29 +1220,29 @@ int main() {
                     
                     if (hoveredModule != -1) {
                         // Add node to existing module
-                        Node newNode;
-                        newNode.position = previewNodePosition;
-                        modules[hoveredModule].nodes.push_back(newNode);
-                        newNodeIndex = (int)modules[hoveredModule].nodes.size() - 1;
+                        EditCommand cmd = MakeEdit(EDIT_ADD_NODE, modules[hoveredModule].id);
+                        cmd.to = previewNodePosition;
+                        PerformEdit(journal, modules, graph, nextModuleId, std::move(cmd));
+                        newNodeIndex = NodeCount(modules[hoveredModule].nodes) - 1;
                         targetModule = hoveredModule;
                         activeModule = hoveredModule;
                     } else {
                         // Create new module with single node
                         GridModule newModule;
-                        Node newNode;
-                        newNode.position = previewNodePosition;
-                        newModule.nodes.push_back(newNode);
                         newModule.center = previewNodePosition;
-                        newModule.id = nextModuleId++;
-                        modules.push_back(newModule);
-                        newNodeIndex = 0;
+                        newModule.id = nextModuleId;
+                        newNodeIndex = AddNode(newModule, previewNodePosition);
+                        
+                        EditCommand cmd = MakeEdit(EDIT_ADD_MODULE, newModule.id);
+                        cmd.module.reset(new GridModule(std::move(newModule)));
+                        cmd.nextModuleIdBefore = nextModuleId;
+                        cmd.nextModuleIdAfter = nextModuleId + 1;
+                        PerformEdit(journal, modules, graph, nextModuleId, std::move(cmd));
                         targetModule = (int)modules.size() - 1;
                         activeModule = targetModule;
                     }
                     
                     // No automatic connection - user must manually connect using MODE_CONNECT
-                    
-                    SaveState(undoHistory, modules, nextModuleId);
                 }
             }
             
@@ -1061,22 +1258,23 @@ int main() {
                         if (connectStartModule == hoveredModule && 
                             !(connectStartNode == hoveredNode && connectStartModule == hoveredModule)) {
                             // Connection within same module (and not the same node)
-                            Node& node1 = modules[connectStartModule].nodes[connectStartNode];
-                            Node& node2 = modules[hoveredModule].nodes[hoveredNode];
-                            
-                            // Add bidirectional connection if it doesn't exist
-                            bool alreadyConnected = false;
-                            for (int conn : node1.connections) {
-                                if (conn == hoveredNode) {
-                                    alreadyConnected = true;
-                                    break;
-                                }
+                            // Add connection if it doesn't exist
+                            if (!HasEdge(modules[hoveredModule].nodes, connectStartNode, hoveredNode)) {
+                                EditCommand cmd = MakeEdit(EDIT_CONNECT, modules[hoveredModule].id);
+                                cmd.node = connectStartNode;
+                                cmd.otherNode = hoveredNode;
+                                PerformEdit(journal, modules, graph, nextModuleId, std::move(cmd));
                             }
-                            
-                            if (!alreadyConnected) {
-                                node1.connections.push_back(hoveredNode);
-                                node2.connections.push_back(connectStartNode);
-                                SaveState(undoHistory, modules, nextModuleId);
+                        } else if (connectStartModule != hoveredModule && connectStartModule < (int)modules.size()) {
+                            // Connection between modules goes into the scene graph
+                            NodeRef start = {modules[connectStartModule].id, connectStartNode};
+                            NodeRef end = {modules[hoveredModule].id, hoveredNode};
+                            if (FindCrossEdge(graph, start, end) == -1) {
+                                EditCommand cmd = MakeEdit(EDIT_CONNECT, start.moduleId);
+                                cmd.node = start.node;
+                                cmd.otherNode = end.node;
+                                cmd.otherModuleId = end.moduleId;
+                                PerformEdit(journal, modules, graph, nextModuleId, std::move(cmd));
                             }
                         }
                         // Reset selection after attempting connection
@@ -1093,52 +1291,134 @@ int main() {
             }
         }
 
+        // Bounds are refit lazily, so bring them up to date before culling against them
+        UpdateScenePicking(modules, scenePick);
+        Frustum frustum = MakeCameraFrustum(camera, (float)GetScreenWidth() / std::max(GetScreenHeight(), 1),
+                                            (float)rlGetCullDistanceNear(), (float)rlGetCullDistanceFar());
+        float viewportHeight = (float)GetScreenHeight();
+        moduleVisibility.assign(modules.size(), FRUSTUM_OUTSIDE);
+        moduleProxy.assign(modules.size(), 0);
+        int visibleModules = 0;
+        ForEachBVHPrimInFrustum(scenePick.tree, frustum, sphereRadius, [&](int m) {
+            BoundingBox bounds = GetModuleBounds(modules[m]);
+            moduleVisibility[m] = TestFrustumBounds(frustum, bounds, sphereRadius);
+            if (moduleVisibility[m] == FRUSTUM_OUTSIDE) return;
+            visibleModules++;
+            
+            Vector3 center = Vector3Scale(Vector3Add(bounds.min, bounds.max), 0.5f);
+            float radius = Vector3Distance(bounds.min, bounds.max) * 0.5f + sphereRadius;
+            moduleProxy[m] = radius * PixelsPerUnit(camera, viewportHeight, center) < MODULE_PROXY_PIXELS;
+        });
+        
         BeginDrawing();
         ClearBackground(BLACK);
         BeginMode3D(camera);
         
+        // Walls, connections and nodes are drawn in separate passes so each is one profiler phase
+        ProfileScope wallScope(profiler, PHASE_WALLS);
         for (size_t m = 0; m < modules.size(); m++) {
-            for (size_t w = 0; w < modules[m].walls.size(); w++) {
-                const Wall& wall = modules[m].walls[w];
-                
-                Color wc = {100, 100, 150, 180};
-                if (cursorEnabled && (int)m == hoveredModule && (int)w == hoveredWall) wc = {255, 100, 100, 220};
-                
-                // Draw wall with texture if available, otherwise use default color
-                DrawWall(wall, modules[m].nodes, wc, true);
+            if (moduleVisibility[m] == FRUSTUM_OUTSIDE) continue;
+            
+            // Untextured walls go through the module batch, textured ones through the mesh cache
+            const GridModule& module = modules[m];
+            int highlightWall = (cursorEnabled && (int)m == hoveredModule) ? hoveredWall : -1;
+            const WallBatch& batch = DrawModuleWalls(wallBatches, module, Color{100, 100, 150, 180}, highlightWall, Color{255, 100, 100, 220});
+            if (batch.texturedWalls.empty()) continue;
+            
+            // In a module that is only partly in view, skip the wall clusters outside it
+            bool cullWalls = moduleVisibility[m] == FRUSTUM_INTERSECTS;
+            if (cullWalls) {
+                visibleWalls.assign(module.walls.size(), 0);
+                ForEachBVHPrimInFrustum(module.pick.wallTree, frustum, 0.0f, [&](int t) {
+                    visibleWalls[module.pick.triangles[t].wall] = 1;
+                });
             }
+            for (int w : batch.texturedWalls) {
+                if (cullWalls && !visibleWalls[w]) continue;
+                DrawWall(wallMeshes, module.walls[w], module.nodes, WHITE, true);
+            }
+        }
+        wallScope.End();
+        
+        if (showConnections) {
+            ProfileScope connectionScope(profiler, PHASE_CONNECTIONS);
+            auto drawConnection = [&](Vector3 a, Vector3 b) {
+                BoundingBox segment = {Vector3Min(a, b), Vector3Max(a, b)};
+                if (TestFrustumBounds(frustum, segment) != FRUSTUM_OUTSIDE) DrawLine3D(a, b, Color{32,32,32,255});
+            };
+            for (size_t m = 0; m < modules.size(); m++) {
+                const GridModule& module = modules[m];
+                if (moduleProxy[m]) continue;
+                if (moduleVisibility[m] == FRUSTUM_INSIDE) {
+                    ForEachEdge(module.nodes, [&](int a, int b) {
+                        DrawLine3D(NodePosition(module.nodes, a), NodePosition(module.nodes, b), Color{32,32,32,255});
+                    });
+                } else if (moduleVisibility[m] == FRUSTUM_INTERSECTS) {
+                    ForEachEdge(module.nodes, [&](int a, int b) {
+                        drawConnection(NodePosition(module.nodes, a), NodePosition(module.nodes, b));
+                    });
+                }
+            }
+            ForEachCrossEdge(graph, [&](NodeRef a, NodeRef b) {
+                int ma = FindModuleIndex(modules, a.moduleId);
+                int mb = FindModuleIndex(modules, b.moduleId);
+                if (ma == -1 || mb == -1 || modules[ma].paged || modules[mb].paged) return;
+                drawConnection(NodePosition(modules[ma].nodes, a.node), NodePosition(modules[mb].nodes, b.node));
+            });
+        }
+        
+        ProfileScope nodeScope(profiler, PHASE_NODES);
+        for (size_t m = 0; m < modules.size(); m++) {
+            if (moduleVisibility[m] == FRUSTUM_OUTSIDE) continue;
             
-            if (showConnections) {
-                for (size_t i = 0; i < modules[m].nodes.size(); i++) {
-                    for (int conn : modules[m].nodes[i].connections) {
-                        if ((int)i < conn) {
-                            DrawLine3D(modules[m].nodes[i].position, modules[m].nodes[conn].position, Color{32,32,32,255});
-                        }
-                    }
+            Color moduleColor = DARKPURPLE;
+            if (cursorEnabled && (int)m == hoveredModule) moduleColor = SKYBLUE;
+            else if (cursorEnabled && (int)m == activeModule) moduleColor = ORANGE;
+            if (moduleProxy[m]) {
+                // A few pixels across: one box over the nodes stands in for all of them
+                BoundingBox bounds = GetModuleBounds(modules[m]);
+                Vector3 size = Vector3AddValue(Vector3Subtract(bounds.max, bounds.min), 2.0f * sphereRadius);
+                DrawCubeV(Vector3Scale(Vector3Add(bounds.min, bounds.max), 0.5f), size, moduleColor);
+                continue;
+            }
+            
+            // Selection flags for this module, so colouring doesn't search selectedNodes per node
+            bool markSelected = cursorEnabled && currentMode == MODE_SELECT && selectedModule == (int)m;
+            if (markSelected) {
+                selectedFlags.assign(NodeCount(modules[m].nodes), 0);
+                for (NodeHandle handle : selectedNodes) {
+                    int idx = ResolveNodeHandle(modules[m].nodes, handle);
+                    if (idx != -1) selectedFlags[idx] = 1;
                 }
             }
             
-            for (size_t i = 0; i < modules[m].nodes.size(); i++) {
-                Color nc = DARKPURPLE;
+            auto addNode = [&](int i) {
+                if (!IsNodeAlive(modules[m].nodes, i)) return;
+                Color nc = moduleColor;
                 
                 if (cursorEnabled) {
-                    if (currentMode == MODE_SELECT && selectedModule == (int)m && 
-                        std::find(selectedNodes.begin(), selectedNodes.end(), (int)i) != selectedNodes.end()) {
+                    if (markSelected && selectedFlags[i]) {
                         nc = YELLOW;
-                    } else if (currentMode == MODE_CONNECT && connectStartNode == (int)i && connectStartModule == (int)m) {
+                    } else if (currentMode == MODE_CONNECT && connectStartNode == i && connectStartModule == (int)m) {
                         nc = LIME; // First selected node for connection
-                    } else if ((int)m == hoveredModule && (int)i == hoveredNode) {
+                    } else if ((int)m == hoveredModule && i == hoveredNode) {
                         nc = (currentMode == MODE_SELECT) ? GREEN : RED;
-                    } else if ((int)m == hoveredModule) {
-                        nc = SKYBLUE;
-                    } else if ((int)m == activeModule) {
-                        nc = ORANGE;
                     }
                 }
                 
-                DrawSphere(modules[m].nodes[i].position, sphereRadius, nc);
+                // Detail follows the node's size on screen; picking still tests the real spheres
+                Vector3 position = NodePosition(modules[m].nodes, i);
+                int level = SelectNodeLOD(sphereRadius * PixelsPerUnit(camera, viewportHeight, position));
+                AddNodeInstance(nodeRenderer, level, position, sphereRadius, nc);
+            };
+            if (moduleVisibility[m] == FRUSTUM_INSIDE) {
+                for (int i = 0; i < NodeCount(modules[m].nodes); i++) addNode(i);
+            } else {
+                ForEachNodeInFrustum(modules[m], frustum, sphereRadius, addNode);
             }
         }
+        DrawNodeInstances(nodeRenderer);
+        nodeScope.End();
         
         // Draw preview node in add mode
         if (showPreviewNode && currentMode == MODE_ADD_NODE) {
@@ -1148,9 +1428,9 @@ int main() {
         
         // Draw connection line preview in connect mode
         if (currentMode == MODE_CONNECT && connectStartNode != -1 && connectStartModule != -1) {
-            Vector3 startPos = modules[connectStartModule].nodes[connectStartNode].position;
-            if (hoveredNode != -1 && hoveredModule != -1 && hoveredModule == connectStartModule) {
-                Vector3 endPos = modules[hoveredModule].nodes[hoveredNode].position;
+            Vector3 startPos = NodePosition(modules[connectStartModule].nodes, connectStartNode);
+            if (hoveredNode != -1 && hoveredModule != -1) {
+                Vector3 endPos = NodePosition(modules[hoveredModule].nodes, hoveredNode);
                 DrawLine3D(startPos, endPos, LIME);
                 DrawSphere(endPos, sphereRadius * 0.5f, LIME);
             } else {
@@ -1174,8 +1454,11 @@ int main() {
         
         EndMode3D();
 
+        ProfileScope hudScope(profiler, PHASE_HUD);
         int tw = 0; for (const auto& mod : modules) tw += mod.walls.size();
-        DrawText(TextFormat("Modules: %zu | Walls: %d | FPS: %d | Active: %d", modules.size(), tw, GetFPS(), activeModule), 10, 10, 18, YELLOW);
+        DrawText(TextFormat("Modules: %zu (%d in view, %d paged out, %.1f MB) | Walls: %d | Textures: %zu (%.1f MB, %d loading) | FPS: %d | Active: %d",
+                            modules.size(), visibleModules, pager.pagedModules, pager.residentBytes / 1048576.0, tw,
+                            textures.assets.size(), textures.residentBytes / 1048576.0, TexturesLoading(textures), GetFPS(), activeModule), 10, 10, 18, YELLOW);
         
         const char* modeName = "";
         Color modeColor = WHITE;
@@ -1201,23 +1484,46 @@ int main() {
             if (connectStartNode == -1) {
                 DrawText("Click first node to start connection", 10, 35, 16, modeColor);
             } else {
-                DrawText("Click second node (same module) to connect | ESC: Cancel", 10, 35, 16, modeColor);
+                DrawText("Click second node (any module) to connect | ESC: Cancel", 10, 35, 16, modeColor);
             }
         }
         
         DrawText(TextFormat("Mode: %s", modeName), 10, 60, 18, modeColor);
         DrawText("1:Select | 2:Move Vertex | 3:Move Module | 4:Add Node | 5:Connect", 10, 85, 14, LIGHTGRAY);
-        DrawText("RMB: Rotate Camera | ARROWS: Move active | G: Grid | C: Connections", 10, 110, 14, LIGHTGRAY);
-        DrawText("TAB: FPS Camera | N: Add module | CTRL+Z: Undo | DEL: Delete", 10, 135, 14, DARKGRAY);
-        DrawText("CTRL+S or F5: Export to OBJ (model.obj)", 10, 160, 14, DARKGRAY);
-        DrawText("T: Load texture on hovered wall (needs texture.png in directory)", 10, 185, 14, DARKGRAY);
-        DrawText("CTRL+S or F5: Export to OBJ (model.obj)", 10, 160, 14, DARKGRAY);
-        DrawText("T: Load texture on hovered wall (needs texture.png in directory)", 10, 185, 14, DARKGRAY);
+        DrawText("RMB: Rotate Camera | ARROWS: Move active | G: Grid | C: Connections | F3: Profiler | F4: Save trace (profile.json)", 10, 110, 14, LIGHTGRAY);
+        DrawText("TAB: FPS Camera | N: Add module | CTRL+Z: Undo | CTRL+Y: Redo | DEL: Delete", 10, 135, 14, DARKGRAY);
+        DrawText("CTRL+S or F5: Export to OBJ (model.obj) | F6: Save project | F9: Open project | CTRL+O: Import OBJ", 10, 160, 14, DARKGRAY);
+        DrawText("T: Load texture on hovered wall (needs texture.png in directory) | F7: Export glTF (model.glb)", 10, 185, 14, DARKGRAY);
+        DrawText("CTRL+S or F5: Export to OBJ (model.obj) | F6: Save project | F9: Open project | CTRL+O: Import OBJ", 10, 160, 14, DARKGRAY);
+        DrawText("T: Load texture on hovered wall (needs texture.png in directory) | F7: Export glTF (model.glb)", 10, 185, 14, DARKGRAY);
+        if (showProfiler) DrawProfilerGraph(profiler, GetScreenWidth() - 490, GetScreenHeight() - 250, 480, 160);
+        hudScope.End();
         
         EndDrawing();
+        EndWallMeshFrame(wallMeshes);
+        EndWallBatchFrame(wallBatches);
+        
+        // Compact modules with many dead node slots while nothing holds on to node indices
+        if (!isDragging && connectStartNode == -1 && selectedNodes.empty()) {
+            for (auto& module : modules) {
+                if (module.paged || !ModuleNeedsCompaction(module)) continue;
+                CompactModuleNodes(module, graph, journal);
+                hoveredNode = -1;
+            }
+        }
+        UploadDecodedTextures(textures, 2.0);
+        TrimTextureCache(textures);
+        UpdateScenePaging(pager, modules, journal, camera.position);
+        EndProfileFrame(profiler);
     }
 
+    UnloadWallMeshCache(wallMeshes);
+    UnloadWallBatchCache(wallBatches);
+    UnloadNodeRenderer(nodeRenderer);
+    WaitObjExport(objExporter);
+    UnloadTextureCache(textures);
+    RemoveScenePages(pager);
     EnableCursor();
     CloseWindow();
     return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,112 @@
+#include "profiler.h"
+#include <cstdio>
+#include <vector>
+#include <algorithm>
+
+const char* ProfilePhaseName(int phase) {
+    static const char* names[PHASE_COUNT] = {
+        "input", "hover", "mode", "undo", "walls", "connections", "nodes", "hud"
+    };
+    return (phase >= 0 && phase < PHASE_COUNT) ? names[phase] : "unknown";
+}
+
+void InitProfiler(Profiler& profiler, size_t capacity) {
+    size_t rounded = 1;
+    while (rounded < capacity) rounded <<= 1;
+    profiler.slots.reset(new ProfileSlot[rounded]);
+    profiler.capacity = rounded;
+    profiler.nextTicket.store(0);
+    profiler.frame.store(0);
+    profiler.origin = std::chrono::steady_clock::now();
+    for (auto& ns : profiler.frameNs) ns.store(0);
+    profiler.historyHead = profiler.historyCount = 0;
+}
+
+int64_t ProfilerNow(const Profiler& profiler) {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - profiler.origin).count();
+}
+
+// Small ids in the order threads first record something, for the trace's tid field
+static uint16_t ProfileThreadId() {
+    static std::atomic<uint16_t> nextId{0};
+    thread_local uint16_t id = nextId.fetch_add(1, std::memory_order_relaxed);
+    return id;
+}
+
+void RecordProfileEvent(Profiler& profiler, ProfilePhase phase, int64_t startNs, int64_t endNs) {
+    profiler.frameNs[phase].fetch_add(endNs - startNs, std::memory_order_relaxed);
+    if (!profiler.slots) return;
+
+    // Claim the next slot, overwriting the oldest event once the ring is full
+    uint64_t ticket = profiler.nextTicket.fetch_add(1, std::memory_order_relaxed);
+    ProfileSlot& slot = profiler.slots[ticket & (profiler.capacity - 1)];
+    slot.sequence.store(2 * ticket + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    slot.startNs.store(startNs, std::memory_order_relaxed);
+    slot.durationNs.store(endNs - startNs, std::memory_order_relaxed);
+    slot.frame.store(profiler.frame.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    slot.phase.store((uint16_t)phase, std::memory_order_relaxed);
+    slot.thread.store(ProfileThreadId(), std::memory_order_relaxed);
+    slot.sequence.store(2 * ticket + 2, std::memory_order_release);
+}
+
+void EndProfileFrame(Profiler& profiler) {
+    float* row = profiler.historyMs[profiler.historyHead];
+    for (int p = 0; p < PHASE_COUNT; p++) {
+        row[p] = profiler.frameNs[p].exchange(0, std::memory_order_relaxed) / 1e6f;
+    }
+    profiler.historyHead = (profiler.historyHead + 1) % PROFILE_HISTORY_FRAMES;
+    if (profiler.historyCount < PROFILE_HISTORY_FRAMES) profiler.historyCount++;
+    profiler.frame.fetch_add(1, std::memory_order_relaxed);
+}
+
+float AverageProfilePhaseMs(const Profiler& profiler, int phase, int frames) {
+    frames = std::min(frames, profiler.historyCount);
+    if (frames <= 0) return 0.0f;
+
+    float total = 0.0f;
+    for (int i = 1; i <= frames; i++) {
+        int row = (profiler.historyHead - i + PROFILE_HISTORY_FRAMES) % PROFILE_HISTORY_FRAMES;
+        total += profiler.historyMs[row][phase];
+    }
+    return total / frames;
+}
+
+bool WriteChromeTrace(const Profiler& profiler, const char* filename) {
+    struct Event { int64_t startNs, durationNs; uint32_t frame; uint16_t phase, thread; };
+
+    // Copy out every complete event still in the ring. A slot whose sequence
+    // changed while it was read was overwritten meanwhile and is skipped.
+    std::vector<Event> events;
+    uint64_t end = profiler.nextTicket.load(std::memory_order_acquire);
+    uint64_t begin = end > profiler.capacity ? end - profiler.capacity : 0;
+    events.reserve((size_t)(end - begin));
+    for (uint64_t ticket = begin; ticket < end; ticket++) {
+        const ProfileSlot& slot = profiler.slots[ticket & (profiler.capacity - 1)];
+        uint64_t before = slot.sequence.load(std::memory_order_acquire);
+        if (before != 2 * ticket + 2) continue;
+        Event e = {slot.startNs.load(std::memory_order_relaxed), slot.durationNs.load(std::memory_order_relaxed),
+                   slot.frame.load(std::memory_order_relaxed), slot.phase.load(std::memory_order_relaxed),
+                   slot.thread.load(std::memory_order_relaxed)};
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (slot.sequence.load(std::memory_order_relaxed) != before) continue;
+        events.push_back(e);
+    }
+    std::sort(events.begin(), events.end(), [](const Event& a, const Event& b) { return a.startNs < b.startNs; });
+
+    FILE* file = fopen(filename, "wb");
+    if (!file) return false;
+
+    // Complete ("X") events with microsecond timestamps, as chrome://tracing and Perfetto expect
+    fprintf(file, "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n");
+    for (size_t i = 0; i < events.size(); i++) {
+        const Event& e = events[i];
+        fprintf(file, "{\"name\": \"%s\", \"cat\": \"frame\", \"ph\": \"X\", \"ts\": %.3f, \"dur\": %.3f, \"pid\": 1, \"tid\": %u, \"args\": {\"frame\": %u}}%s\n",
+                ProfilePhaseName(e.phase), e.startNs / 1e3, e.durationNs / 1e3, (unsigned)e.thread, (unsigned)e.frame,
+                i + 1 < events.size() ? "," : "");
+    }
+    fprintf(file, "]}\n");
+
+    bool ok = ferror(file) == 0;
+    return fclose(file) == 0 && ok;
+}
@@ -0,0 +1,83 @@
+// Frame phase profiler. Scoped timers record events into a lock-free ring
+// buffer that keeps the most recent events for a Chrome trace dump, and add
+// their time to per-phase totals that EndProfileFrame moves into a rolling
+// history for the on-screen graph.
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <atomic>
+#include <memory>
+#include <chrono>
+
+enum ProfilePhase {
+    PHASE_INPUT,
+    PHASE_HOVER,
+    PHASE_MODE,
+    PHASE_UNDO,
+    PHASE_WALLS,
+    PHASE_CONNECTIONS,
+    PHASE_NODES,
+    PHASE_HUD,
+    PHASE_COUNT
+};
+
+// One timed interval. 'sequence' is odd while a writer fills the slot and
+// 2 * (ticket + 1) once ticket's event is complete, so readers can tell a
+// finished event from one being overwritten. The fields are relaxed atomics
+// only so a reader racing a writer is well defined; they cost plain stores.
+struct ProfileSlot {
+    std::atomic<uint64_t> sequence{0};
+    std::atomic<int64_t> startNs{0};
+    std::atomic<int64_t> durationNs{0};
+    std::atomic<uint32_t> frame{0};
+    std::atomic<uint16_t> phase{0};
+    std::atomic<uint16_t> thread{0};
+};
+
+static const int PROFILE_HISTORY_FRAMES = 240;
+
+struct Profiler {
+    std::unique_ptr<ProfileSlot[]> slots;
+    size_t capacity = 0; // Power of two
+    std::atomic<uint64_t> nextTicket{0};
+    std::atomic<uint32_t> frame{0};
+    std::chrono::steady_clock::time_point origin;
+
+    // Time spent in each phase during the current frame, from any thread
+    std::atomic<int64_t> frameNs[PHASE_COUNT] = {};
+
+    // Per-frame phase times in milliseconds, written by EndProfileFrame only
+    float historyMs[PROFILE_HISTORY_FRAMES][PHASE_COUNT] = {};
+    int historyHead = 0; // Slot the next frame goes into
+    int historyCount = 0;
+};
+
+const char* ProfilePhaseName(int phase);
+void InitProfiler(Profiler& profiler, size_t capacity = 1 << 16);
+int64_t ProfilerNow(const Profiler& profiler);
+void RecordProfileEvent(Profiler& profiler, ProfilePhase phase, int64_t startNs, int64_t endNs);
+void EndProfileFrame(Profiler& profiler);
+// Average time of a phase over the last 'frames' frames of history, in milliseconds
+float AverageProfilePhaseMs(const Profiler& profiler, int phase, int frames);
+bool WriteChromeTrace(const Profiler& profiler, const char* filename);
+
+// Times the enclosing scope, or up to End() when the phase finishes before the scope does
+struct ProfileScope {
+    Profiler& profiler;
+    ProfilePhase phase;
+    int64_t startNs;
+    bool running = true;
+
+    ProfileScope(Profiler& profiler, ProfilePhase phase)
+        : profiler(profiler), phase(phase), startNs(ProfilerNow(profiler)) {}
+    ~ProfileScope() { End(); }
+    ProfileScope(const ProfileScope&) = delete;
+    ProfileScope& operator=(const ProfileScope&) = delete;
+
+    void End() {
+        if (!running) return;
+        running = false;
+        RecordProfileEvent(profiler, phase, startNs, ProfilerNow(profiler));
+    }
+};
@@ -0,0 +1,337 @@
+#include "ray_kernels.h"
+#include <atomic>
+#include <algorithm>
+#include <cstring>
+
+// The vector kernels are compiled for their instruction set with target
+// attributes, so the rest of the build keeps the baseline and the choice is
+// made at run time. MSVC on x64 gets the SSE kernel, which needs no detection.
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define RAY_KERNELS_SSE 1
+#define RAY_KERNELS_AVX2 1
+#define RAY_KERNEL_TARGET(isa) __attribute__((target(isa)))
+#include <immintrin.h>
+#elif defined(_MSC_VER) && defined(_M_X64)
+#define RAY_KERNELS_SSE 1
+#define RAY_KERNEL_TARGET(isa)
+#include <immintrin.h>
+#endif
+
+const char* RayKernelISAName(RayKernelISA isa) {
+    switch (isa) {
+        case RAY_KERNEL_SSE: return "sse";
+        case RAY_KERNEL_AVX2: return "avx2";
+        default: return "scalar";
+    }
+}
+
+static RayKernelISA DetectRayKernelISA() {
+#if defined(RAY_KERNELS_AVX2)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) return RAY_KERNEL_AVX2;
+    if (__builtin_cpu_supports("sse2")) return RAY_KERNEL_SSE;
+    return RAY_KERNEL_SCALAR;
+#elif defined(RAY_KERNELS_SSE)
+    return RAY_KERNEL_SSE;
+#else
+    return RAY_KERNEL_SCALAR;
+#endif
+}
+
+static RayKernelISA SupportedRayKernelISA() {
+    static const RayKernelISA supported = DetectRayKernelISA();
+    return supported;
+}
+
+static std::atomic<int> selectedRayKernelISA{-1}; // -1 until SelectRayKernelISA is called
+
+RayKernelISA ActiveRayKernelISA() {
+    int selected = selectedRayKernelISA.load(std::memory_order_relaxed);
+    return selected < 0 ? SupportedRayKernelISA() : (RayKernelISA)selected;
+}
+
+RayKernelISA SelectRayKernelISA(RayKernelISA isa) {
+    isa = std::min(isa, SupportedRayKernelISA());
+    selectedRayKernelISA.store(isa, std::memory_order_relaxed);
+    return isa;
+}
+
+// Spheres [first, count) one at a time, continuing from 'hit'
+static RayHit IntersectRaySpheresScalar(const Ray& ray, const float* x, const float* y, const float* z, const uint8_t* alive,
+                                        int first, int count, float radius, RayHit hit) {
+    for (int i = first; i < count; i++) {
+        if (alive && !alive[i]) continue;
+        float t = RaySphereDistance(ray, x[i], y[i], z[i], radius);
+        if (t >= 0.0f && t < hit.distance) {
+            hit.distance = t;
+            hit.index = i;
+        }
+    }
+    return hit;
+}
+
+// Best lane of a vector kernel's per-lane results, lowest index on ties
+static RayHit ReduceLanes(const float* distances, const int* indices, int lanes, RayHit hit) {
+    for (int lane = 0; lane < lanes; lane++) {
+        if (indices[lane] < 0) continue;
+        if (distances[lane] < hit.distance || (distances[lane] == hit.distance && indices[lane] < hit.index)) {
+            hit.distance = distances[lane];
+            hit.index = indices[lane];
+        }
+    }
+    return hit;
+}
+
+// Each lane keeps the nearest hit among the spheres it saw. The arithmetic
+// follows RaySphereDistance step for step so every kernel rounds alike.
+#if defined(RAY_KERNELS_SSE)
+RAY_KERNEL_TARGET("sse2")
+static RayHit IntersectRaySpheresSSE(const Ray& ray, const float* x, const float* y, const float* z, const uint8_t* alive,
+                                     int count, float radius, float maxDistance) {
+    const __m128 px = _mm_set1_ps(ray.position.x), py = _mm_set1_ps(ray.position.y), pz = _mm_set1_ps(ray.position.z);
+    const __m128 dx = _mm_set1_ps(ray.direction.x), dy = _mm_set1_ps(ray.direction.y), dz = _mm_set1_ps(ray.direction.z);
+    const __m128 radiusSq = _mm_set1_ps(radius * radius);
+    const __m128 zero = _mm_setzero_ps();
+    const __m128i zeroInt = _mm_setzero_si128();
+    __m128 bestT = _mm_set1_ps(maxDistance);
+    __m128i bestIndex = _mm_set1_epi32(-1);
+    __m128i index = _mm_setr_epi32(0, 1, 2, 3);
+    
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128 ox = _mm_sub_ps(_mm_loadu_ps(x + i), px);
+        __m128 oy = _mm_sub_ps(_mm_loadu_ps(y + i), py);
+        __m128 oz = _mm_sub_ps(_mm_loadu_ps(z + i), pz);
+        __m128 along = _mm_add_ps(_mm_add_ps(_mm_mul_ps(ox, dx), _mm_mul_ps(oy, dy)), _mm_mul_ps(oz, dz));
+        __m128 lengthSq = _mm_add_ps(_mm_add_ps(_mm_mul_ps(ox, ox), _mm_mul_ps(oy, oy)), _mm_mul_ps(oz, oz));
+        __m128 d = _mm_sub_ps(radiusSq, _mm_sub_ps(lengthSq, _mm_mul_ps(along, along)));
+        __m128 root = _mm_sqrt_ps(_mm_max_ps(d, zero));
+        __m128 inside = _mm_cmplt_ps(lengthSq, radiusSq);
+        __m128 t = _mm_or_ps(_mm_and_ps(inside, _mm_add_ps(along, root)), _mm_andnot_ps(inside, _mm_sub_ps(along, root)));
+        
+        __m128 better = _mm_and_ps(_mm_cmpge_ps(d, zero), _mm_and_ps(_mm_cmpge_ps(t, zero), _mm_cmplt_ps(t, bestT)));
+        if (alive) {
+            int bytes;
+            memcpy(&bytes, alive + i, sizeof(bytes));
+            __m128i flags = _mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(bytes), zeroInt), zeroInt);
+            better = _mm_and_ps(better, _mm_castsi128_ps(_mm_cmpgt_epi32(flags, zeroInt)));
+        }
+        bestT = _mm_or_ps(_mm_and_ps(better, t), _mm_andnot_ps(better, bestT));
+        __m128i betterInt = _mm_castps_si128(better);
+        bestIndex = _mm_or_si128(_mm_and_si128(betterInt, index), _mm_andnot_si128(betterInt, bestIndex));
+        index = _mm_add_epi32(index, _mm_set1_epi32(4));
+    }
+    
+    alignas(16) float distances[4];
+    alignas(16) int indices[4];
+    _mm_store_ps(distances, bestT);
+    _mm_store_si128((__m128i*)indices, bestIndex);
+    RayHit hit = ReduceLanes(distances, indices, 4, {-1, maxDistance});
+    return IntersectRaySpheresScalar(ray, x, y, z, alive, i, count, radius, hit);
+}
+#endif
+
+#if defined(RAY_KERNELS_AVX2)
+RAY_KERNEL_TARGET("avx2")
+static RayHit IntersectRaySpheresAVX2(const Ray& ray, const float* x, const float* y, const float* z, const uint8_t* alive,
+                                      int count, float radius, float maxDistance) {
+    const __m256 px = _mm256_set1_ps(ray.position.x), py = _mm256_set1_ps(ray.position.y), pz = _mm256_set1_ps(ray.position.z);
+    const __m256 dx = _mm256_set1_ps(ray.direction.x), dy = _mm256_set1_ps(ray.direction.y), dz = _mm256_set1_ps(ray.direction.z);
+    const __m256 radiusSq = _mm256_set1_ps(radius * radius);
+    const __m256 zero = _mm256_setzero_ps();
+    __m256 bestT = _mm256_set1_ps(maxDistance);
+    __m256i bestIndex = _mm256_set1_epi32(-1);
+    __m256i index = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+    
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256 ox = _mm256_sub_ps(_mm256_loadu_ps(x + i), px);
+        __m256 oy = _mm256_sub_ps(_mm256_loadu_ps(y + i), py);
+        __m256 oz = _mm256_sub_ps(_mm256_loadu_ps(z + i), pz);
+        __m256 along = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(ox, dx), _mm256_mul_ps(oy, dy)), _mm256_mul_ps(oz, dz));
+        __m256 lengthSq = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(ox, ox), _mm256_mul_ps(oy, oy)), _mm256_mul_ps(oz, oz));
+        __m256 d = _mm256_sub_ps(radiusSq, _mm256_sub_ps(lengthSq, _mm256_mul_ps(along, along)));
+        __m256 root = _mm256_sqrt_ps(_mm256_max_ps(d, zero));
+        __m256 inside = _mm256_cmp_ps(lengthSq, radiusSq, _CMP_LT_OQ);
+        __m256 t = _mm256_blendv_ps(_mm256_sub_ps(along, root), _mm256_add_ps(along, root), inside);
+        
+        __m256 better = _mm256_and_ps(_mm256_cmp_ps(d, zero, _CMP_GE_OQ),
+                                      _mm256_and_ps(_mm256_cmp_ps(t, zero, _CMP_GE_OQ), _mm256_cmp_ps(t, bestT, _CMP_LT_OQ)));
+        if (alive) {
+            __m256i flags = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)(alive + i)));
+            better = _mm256_and_ps(better, _mm256_castsi256_ps(_mm256_cmpgt_epi32(flags, _mm256_setzero_si256())));
+        }
+        bestT = _mm256_blendv_ps(bestT, t, better);
+        bestIndex = _mm256_castps_si256(_mm256_blendv_ps(_mm256_castsi256_ps(bestIndex), _mm256_castsi256_ps(index), better));
+        index = _mm256_add_epi32(index, _mm256_set1_epi32(8));
+    }
+    
+    alignas(32) float distances[8];
+    alignas(32) int indices[8];
+    _mm256_store_ps(distances, bestT);
+    _mm256_store_si256((__m256i*)indices, bestIndex);
+    RayHit hit = ReduceLanes(distances, indices, 8, {-1, maxDistance});
+    return IntersectRaySpheresScalar(ray, x, y, z, alive, i, count, radius, hit);
+}
+#endif
+
+RayHit IntersectRaySpheres(const Ray& ray, const float* x, const float* y, const float* z, const uint8_t* alive,
+                           int count, float radius, float maxDistance) {
+    switch (ActiveRayKernelISA()) {
+#if defined(RAY_KERNELS_AVX2)
+        case RAY_KERNEL_AVX2: return IntersectRaySpheresAVX2(ray, x, y, z, alive, count, radius, maxDistance);
+#endif
+#if defined(RAY_KERNELS_SSE)
+        case RAY_KERNEL_SSE: return IntersectRaySpheresSSE(ray, x, y, z, alive, count, radius, maxDistance);
+#endif
+        default: return IntersectRaySpheresScalar(ray, x, y, z, alive, 0, count, radius, {-1, maxDistance});
+    }
+}
+
+void ResizeTrianglePack(TrianglePack& pack, int count) {
+    for (std::vector<float>* array : {&pack.v0x, &pack.v0y, &pack.v0z, &pack.e1x, &pack.e1y, &pack.e1z,
+                                      &pack.e2x, &pack.e2y, &pack.e2z}) {
+        array->resize(count);
+    }
+}
+
+void SetPackedTriangle(TrianglePack& pack, int i, Vector3 v0, Vector3 v1, Vector3 v2) {
+    pack.v0x[i] = v0.x;
+    pack.v0y[i] = v0.y;
+    pack.v0z[i] = v0.z;
+    pack.e1x[i] = v1.x - v0.x;
+    pack.e1y[i] = v1.y - v0.y;
+    pack.e1z[i] = v1.z - v0.z;
+    pack.e2x[i] = v2.x - v0.x;
+    pack.e2y[i] = v2.y - v0.y;
+    pack.e2z[i] = v2.z - v0.z;
+}
+
+// Triangles [first, end) one at a time, continuing from 'hit'
+static RayHit IntersectRayTrianglesScalar(const Ray& ray, const TrianglePack& pack, int first, int end, RayHit hit) {
+    for (int i = first; i < end; i++) {
+        float t = RayTriangleDistance(ray, pack.v0x[i], pack.v0y[i], pack.v0z[i], pack.e1x[i], pack.e1y[i], pack.e1z[i],
+                                      pack.e2x[i], pack.e2y[i], pack.e2z[i]);
+        if (t >= 0.0f && t < hit.distance) {
+            hit.distance = t;
+            hit.index = i;
+        }
+    }
+    return hit;
+}
+
+// Same lane scheme as the sphere kernels. Instead of returning early, each
+// rejection test of RayTriangleDistance clears the lane from the mask.
+#if defined(RAY_KERNELS_SSE)
+RAY_KERNEL_TARGET("sse2")
+static RayHit IntersectRayTrianglesSSE(const Ray& ray, const TrianglePack& pack, int first, int count, float maxDistance) {
+    const __m128 px = _mm_set1_ps(ray.position.x), py = _mm_set1_ps(ray.position.y), pz = _mm_set1_ps(ray.position.z);
+    const __m128 dx = _mm_set1_ps(ray.direction.x), dy = _mm_set1_ps(ray.direction.y), dz = _mm_set1_ps(ray.direction.z);
+    const __m128 epsilon = _mm_set1_ps(RAY_TRIANGLE_EPSILON), negEpsilon = _mm_set1_ps(-RAY_TRIANGLE_EPSILON);
+    const __m128 zero = _mm_setzero_ps(), one = _mm_set1_ps(1.0f);
+    __m128 bestT = _mm_set1_ps(maxDistance);
+    __m128i bestIndex = _mm_set1_epi32(-1);
+    __m128i index = _mm_setr_epi32(first, first + 1, first + 2, first + 3);
+    
+    int i = first, end = first + count;
+    for (; i + 4 <= end; i += 4) {
+        __m128 e1x = _mm_loadu_ps(&pack.e1x[i]), e1y = _mm_loadu_ps(&pack.e1y[i]), e1z = _mm_loadu_ps(&pack.e1z[i]);
+        __m128 e2x = _mm_loadu_ps(&pack.e2x[i]), e2y = _mm_loadu_ps(&pack.e2y[i]), e2z = _mm_loadu_ps(&pack.e2z[i]);
+        __m128 hx = _mm_sub_ps(_mm_mul_ps(dy, e2z), _mm_mul_ps(dz, e2y));
+        __m128 hy = _mm_sub_ps(_mm_mul_ps(dz, e2x), _mm_mul_ps(dx, e2z));
+        __m128 hz = _mm_sub_ps(_mm_mul_ps(dx, e2y), _mm_mul_ps(dy, e2x));
+        __m128 det = _mm_add_ps(_mm_add_ps(_mm_mul_ps(e1x, hx), _mm_mul_ps(e1y, hy)), _mm_mul_ps(e1z, hz));
+        __m128 invDet = _mm_div_ps(one, det);
+        
+        __m128 tx = _mm_sub_ps(px, _mm_loadu_ps(&pack.v0x[i]));
+        __m128 ty = _mm_sub_ps(py, _mm_loadu_ps(&pack.v0y[i]));
+        __m128 tz = _mm_sub_ps(pz, _mm_loadu_ps(&pack.v0z[i]));
+        __m128 u = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(tx, hx), _mm_mul_ps(ty, hy)), _mm_mul_ps(tz, hz)), invDet);
+        
+        __m128 qx = _mm_sub_ps(_mm_mul_ps(ty, e1z), _mm_mul_ps(tz, e1y));
+        __m128 qy = _mm_sub_ps(_mm_mul_ps(tz, e1x), _mm_mul_ps(tx, e1z));
+        __m128 qz = _mm_sub_ps(_mm_mul_ps(tx, e1y), _mm_mul_ps(ty, e1x));
+        __m128 v = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, qx), _mm_mul_ps(dy, qy)), _mm_mul_ps(dz, qz)), invDet);
+        __m128 t = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(e2x, qx), _mm_mul_ps(e2y, qy)), _mm_mul_ps(e2z, qz)), invDet);
+        
+        __m128 better = _mm_or_ps(_mm_cmple_ps(det, negEpsilon), _mm_cmpge_ps(det, epsilon));
+        better = _mm_and_ps(better, _mm_and_ps(_mm_cmpge_ps(u, zero), _mm_cmple_ps(u, one)));
+        better = _mm_and_ps(better, _mm_and_ps(_mm_cmpge_ps(v, zero), _mm_cmple_ps(_mm_add_ps(u, v), one)));
+        better = _mm_and_ps(better, _mm_and_ps(_mm_cmpgt_ps(t, epsilon), _mm_cmplt_ps(t, bestT)));
+        bestT = _mm_or_ps(_mm_and_ps(better, t), _mm_andnot_ps(better, bestT));
+        __m128i betterInt = _mm_castps_si128(better);
+        bestIndex = _mm_or_si128(_mm_and_si128(betterInt, index), _mm_andnot_si128(betterInt, bestIndex));
+        index = _mm_add_epi32(index, _mm_set1_epi32(4));
+    }
+    
+    alignas(16) float distances[4];
+    alignas(16) int indices[4];
+    _mm_store_ps(distances, bestT);
+    _mm_store_si128((__m128i*)indices, bestIndex);
+    RayHit hit = ReduceLanes(distances, indices, 4, {-1, maxDistance});
+    return IntersectRayTrianglesScalar(ray, pack, i, end, hit);
+}
+#endif
+
+#if defined(RAY_KERNELS_AVX2)
+RAY_KERNEL_TARGET("avx2")
+static RayHit IntersectRayTrianglesAVX2(const Ray& ray, const TrianglePack& pack, int first, int count, float maxDistance) {
+    const __m256 px = _mm256_set1_ps(ray.position.x), py = _mm256_set1_ps(ray.position.y), pz = _mm256_set1_ps(ray.position.z);
+    const __m256 dx = _mm256_set1_ps(ray.direction.x), dy = _mm256_set1_ps(ray.direction.y), dz = _mm256_set1_ps(ray.direction.z);
+    const __m256 epsilon = _mm256_set1_ps(RAY_TRIANGLE_EPSILON), negEpsilon = _mm256_set1_ps(-RAY_TRIANGLE_EPSILON);
+    const __m256 zero = _mm256_setzero_ps(), one = _mm256_set1_ps(1.0f);
+    __m256 bestT = _mm256_set1_ps(maxDistance);
+    __m256i bestIndex = _mm256_set1_epi32(-1);
+    __m256i index = _mm256_add_epi32(_mm256_set1_epi32(first), _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+    
+    int i = first, end = first + count;
+    for (; i + 8 <= end; i += 8) {
+        __m256 e1x = _mm256_loadu_ps(&pack.e1x[i]), e1y = _mm256_loadu_ps(&pack.e1y[i]), e1z = _mm256_loadu_ps(&pack.e1z[i]);
+        __m256 e2x = _mm256_loadu_ps(&pack.e2x[i]), e2y = _mm256_loadu_ps(&pack.e2y[i]), e2z = _mm256_loadu_ps(&pack.e2z[i]);
+        __m256 hx = _mm256_sub_ps(_mm256_mul_ps(dy, e2z), _mm256_mul_ps(dz, e2y));
+        __m256 hy = _mm256_sub_ps(_mm256_mul_ps(dz, e2x), _mm256_mul_ps(dx, e2z));
+        __m256 hz = _mm256_sub_ps(_mm256_mul_ps(dx, e2y), _mm256_mul_ps(dy, e2x));
+        __m256 det = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(e1x, hx), _mm256_mul_ps(e1y, hy)), _mm256_mul_ps(e1z, hz));
+        __m256 invDet = _mm256_div_ps(one, det);
+        
+        __m256 tx = _mm256_sub_ps(px, _mm256_loadu_ps(&pack.v0x[i]));
+        __m256 ty = _mm256_sub_ps(py, _mm256_loadu_ps(&pack.v0y[i]));
+        __m256 tz = _mm256_sub_ps(pz, _mm256_loadu_ps(&pack.v0z[i]));
+        __m256 u = _mm256_mul_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(tx, hx), _mm256_mul_ps(ty, hy)), _mm256_mul_ps(tz, hz)), invDet);
+        
+        __m256 qx = _mm256_sub_ps(_mm256_mul_ps(ty, e1z), _mm256_mul_ps(tz, e1y));
+        __m256 qy = _mm256_sub_ps(_mm256_mul_ps(tz, e1x), _mm256_mul_ps(tx, e1z));
+        __m256 qz = _mm256_sub_ps(_mm256_mul_ps(tx, e1y), _mm256_mul_ps(ty, e1x));
+        __m256 v = _mm256_mul_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(dx, qx), _mm256_mul_ps(dy, qy)), _mm256_mul_ps(dz, qz)), invDet);
+        __m256 t = _mm256_mul_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(e2x, qx), _mm256_mul_ps(e2y, qy)), _mm256_mul_ps(e2z, qz)), invDet);
+        
+        __m256 better = _mm256_or_ps(_mm256_cmp_ps(det, negEpsilon, _CMP_LE_OQ), _mm256_cmp_ps(det, epsilon, _CMP_GE_OQ));
+        better = _mm256_and_ps(better, _mm256_and_ps(_mm256_cmp_ps(u, zero, _CMP_GE_OQ), _mm256_cmp_ps(u, one, _CMP_LE_OQ)));
+        better = _mm256_and_ps(better, _mm256_and_ps(_mm256_cmp_ps(v, zero, _CMP_GE_OQ),
+                                                     _mm256_cmp_ps(_mm256_add_ps(u, v), one, _CMP_LE_OQ)));
+        better = _mm256_and_ps(better, _mm256_and_ps(_mm256_cmp_ps(t, epsilon, _CMP_GT_OQ), _mm256_cmp_ps(t, bestT, _CMP_LT_OQ)));
+        bestT = _mm256_blendv_ps(bestT, t, better);
+        bestIndex = _mm256_castps_si256(_mm256_blendv_ps(_mm256_castsi256_ps(bestIndex), _mm256_castsi256_ps(index), better));
+        index = _mm256_add_epi32(index, _mm256_set1_epi32(8));
+    }
+    
+    alignas(32) float distances[8];
+    alignas(32) int indices[8];
+    _mm256_store_ps(distances, bestT);
+    _mm256_store_si256((__m256i*)indices, bestIndex);
+    RayHit hit = ReduceLanes(distances, indices, 8, {-1, maxDistance});
+    return IntersectRayTrianglesScalar(ray, pack, i, end, hit);
+}
+#endif
+
+RayHit IntersectRayTriangles(const Ray& ray, const TrianglePack& pack, int first, int count, float maxDistance) {
+    switch (ActiveRayKernelISA()) {
+#if defined(RAY_KERNELS_AVX2)
+        case RAY_KERNEL_AVX2: return IntersectRayTrianglesAVX2(ray, pack, first, count, maxDistance);
+#endif
+#if defined(RAY_KERNELS_SSE)
+        case RAY_KERNEL_SSE: return IntersectRayTrianglesSSE(ray, pack, first, count, maxDistance);
+#endif
+        default: return IntersectRayTrianglesScalar(ray, pack, first, first + count, {-1, maxDistance});
+    }
+}
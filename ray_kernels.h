@@ -0,0 +1,89 @@
+// Batched ray intersection kernels for picking. Each kernel has a scalar
+// version and SSE/AVX2 versions that test several primitives per step; the
+// widest one the CPU supports is chosen on first use.
+#pragma once
+
+#include "raylib.h"
+#include <cstdint>
+#include <cmath>
+#include <vector>
+
+enum RayKernelISA {
+    RAY_KERNEL_SCALAR,
+    RAY_KERNEL_SSE,  // 4 primitives per step
+    RAY_KERNEL_AVX2, // 8 primitives per step
+};
+
+const char* RayKernelISAName(RayKernelISA isa);
+RayKernelISA ActiveRayKernelISA();
+// Use a narrower kernel than the CPU allows, for comparing them; requests the CPU can't run are lowered
+RayKernelISA SelectRayKernelISA(RayKernelISA isa);
+
+struct RayHit {
+    int index;      // -1 when nothing was hit
+    float distance;
+};
+
+// Distance along the ray to a sphere, as GetRayCollisionSphere measures it (the
+// exit point when the origin is inside), or -1 for a miss or a sphere behind the ray.
+// Every kernel computes exactly this, so scalar and vector picks agree.
+inline float RaySphereDistance(const Ray& ray, float cx, float cy, float cz, float radius) {
+    float ox = cx - ray.position.x, oy = cy - ray.position.y, oz = cz - ray.position.z;
+    float along = ox * ray.direction.x + oy * ray.direction.y + oz * ray.direction.z;
+    float lengthSq = ox * ox + oy * oy + oz * oz;
+    float radiusSq = radius * radius;
+    float d = radiusSq - (lengthSq - along * along);
+    if (d < 0.0f) return -1.0f;
+    float t = lengthSq < radiusSq ? along + sqrtf(d) : along - sqrtf(d);
+    return t >= 0.0f ? t : -1.0f;
+}
+
+// Nearest of 'count' spheres of one radius, centres in separate coordinate
+// arrays, hit closer than maxDistance. Spheres whose 'alive' byte is 0 are
+// skipped; alive may be null. Ties go to the lowest index.
+RayHit IntersectRaySpheres(const Ray& ray, const float* x, const float* y, const float* z, const uint8_t* alive,
+                           int count, float radius, float maxDistance);
+
+// Triangles as one corner and the two edges leaving it, each coordinate in its
+// own array so a kernel step loads 4 or 8 triangles with plain vector loads
+struct TrianglePack {
+    std::vector<float> v0x, v0y, v0z;
+    std::vector<float> e1x, e1y, e1z; // v1 - v0
+    std::vector<float> e2x, e2y, e2z; // v2 - v0
+};
+
+void ResizeTrianglePack(TrianglePack& pack, int count);
+void SetPackedTriangle(TrianglePack& pack, int i, Vector3 v0, Vector3 v1, Vector3 v2);
+
+static const float RAY_TRIANGLE_EPSILON = 0.000001f; // raylib's EPSILON
+
+// Möller–Trumbore from a corner and its two edges, with the same operations and
+// tolerances as GetRayCollisionTriangle. Returns the hit distance or -1.
+inline float RayTriangleDistance(const Ray& ray, float v0x, float v0y, float v0z,
+                                 float e1x, float e1y, float e1z, float e2x, float e2y, float e2z) {
+    const Vector3& d = ray.direction;
+    float px = d.y * e2z - d.z * e2y, py = d.z * e2x - d.x * e2z, pz = d.x * e2y - d.y * e2x;
+    float det = e1x * px + e1y * py + e1z * pz;
+    if (det > -RAY_TRIANGLE_EPSILON && det < RAY_TRIANGLE_EPSILON) return -1.0f;
+    float invDet = 1.0f / det;
+    
+    float tx = ray.position.x - v0x, ty = ray.position.y - v0y, tz = ray.position.z - v0z;
+    float u = (tx * px + ty * py + tz * pz) * invDet;
+    if (u < 0.0f || u > 1.0f) return -1.0f;
+    
+    float qx = ty * e1z - tz * e1y, qy = tz * e1x - tx * e1z, qz = tx * e1y - ty * e1x;
+    float v = (d.x * qx + d.y * qy + d.z * qz) * invDet;
+    if (v < 0.0f || u + v > 1.0f) return -1.0f;
+    
+    float t = (e2x * qx + e2y * qy + e2z * qz) * invDet;
+    return t > RAY_TRIANGLE_EPSILON ? t : -1.0f;
+}
+
+inline float RayTriangleDistance(const Ray& ray, Vector3 v0, Vector3 v1, Vector3 v2) {
+    return RayTriangleDistance(ray, v0.x, v0.y, v0.z, v1.x - v0.x, v1.y - v0.y, v1.z - v0.z,
+                               v2.x - v0.x, v2.y - v0.y, v2.z - v0.z);
+}
+
+// Nearest of the packed triangles [first, first + count) hit closer than
+// maxDistance; the index is into the pack. Ties go to the lowest index.
+RayHit IntersectRayTriangles(const Ray& ray, const TrianglePack& pack, int first, int count, float maxDistance);
@@ -0,0 +1,3590 @@
+#include "scene.h"
+#include <cmath>
+#include <cstdio>
+#include <cfloat>
+#include <algorithm>
+#include <fstream>
+#include <cstring>
+#include <charconv>
+#include <functional>
+#include <chrono>
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+// Runs fn(i) for i in [0, count) across the hardware threads, returning when all are done
+template <typename Fn>
+void ParallelFor(size_t count, Fn fn) {
+    std::atomic<size_t> next{0};
+    auto work = [&]() {
+        for (size_t i = next++; i < count; i = next++) fn(i);
+    };
+    size_t threadCount = std::min<size_t>(std::max(1u, std::thread::hardware_concurrency()), count);
+    std::vector<std::thread> helpers;
+    for (size_t t = 1; t < threadCount; t++) helpers.emplace_back(work);
+    work();
+    for (auto& helper : helpers) helper.join();
+}
+
+unsigned int NextModuleRevision() {
+    static unsigned int nextRevision = 1;
+    return nextRevision++;
+}
+
+// Number of slots, dead ones included; loops over nodes run to this and skip dead slots
+int NodeCount(const NodeStore& store) {
+    if (store.implicitLattice) return LatticeNodeCount(store.lattice);
+    return (int)store.x.size();
+}
+
+// Every node of an implicit lattice is alive and still at generation 0
+bool IsNodeAlive(const NodeStore& store, int i) {
+    return i >= 0 && i < NodeCount(store) && (store.implicitLattice || store.alive[i]);
+}
+
+NodeHandle GetNodeHandle(const NodeStore& store, int i) {
+    return {i, store.implicitLattice ? 0u : store.generation[i]};
+}
+
+// Slot the handle refers to, or -1 if that node has been deleted
+int ResolveNodeHandle(const NodeStore& store, NodeHandle handle) {
+    if (!IsNodeAlive(store, handle.slot)) return -1;
+    uint32_t generation = store.implicitLattice ? 0u : store.generation[handle.slot];
+    return generation == handle.generation ? handle.slot : -1;
+}
+
+Vector3 NodePosition(const NodeStore& store, int i) {
+    if (store.implicitLattice) return LatticeNodePosition(store.lattice, i);
+    return {store.x[i], store.y[i], store.z[i]};
+}
+
+void SetNodePosition(NodeStore& store, int i, Vector3 p) {
+    MaterializeNodeStore(store);
+    store.x[i] = p.x;
+    store.y[i] = p.y;
+    store.z[i] = p.z;
+}
+
+void PushNode(NodeStore& store, Vector3 p) {
+    MaterializeNodeStore(store);
+    store.x.push_back(p.x);
+    store.y.push_back(p.y);
+    store.z.push_back(p.z);
+    store.generation.push_back(0);
+    store.alive.push_back(1);
+    store.liveCount++;
+}
+
+int CompactedRowCount(const NodeStore& store) {
+    return store.offsets.empty() ? 0 : (int)store.offsets.size() - 1;
+}
+
+bool HasEdge(const NodeStore& store, int a, int b) {
+    bool found = false;
+    ForEachNeighbor(store, a, [&](int n) { if (n == b) found = true; });
+    return found;
+}
+
+// Rebuild the CSR arrays from the current rows and the overflow, dropping
+// removed entries. remap(old) gives a node's new index, or -1 to drop it.
+template <typename RemapFn>
+void RebuildAdjacency(NodeStore& store, int newCount, RemapFn remap) {
+    std::vector<int> offsets(newCount + 1, 0);
+    ForEachEdge(store, [&](int a, int b) {
+        a = remap(a);
+        b = remap(b);
+        if (a < 0 || b < 0) return;
+        offsets[a + 1]++;
+        offsets[b + 1]++;
+    });
+    for (int i = 0; i < newCount; i++) offsets[i + 1] += offsets[i];
+    
+    std::vector<int> targets(offsets[newCount]);
+    std::vector<int> fill(offsets.begin(), offsets.end() - 1);
+    ForEachEdge(store, [&](int a, int b) {
+        a = remap(a);
+        b = remap(b);
+        if (a < 0 || b < 0) return;
+        targets[fill[a]++] = b;
+        targets[fill[b]++] = a;
+    });
+    
+    store.offsets.swap(offsets);
+    store.targets.swap(targets);
+    store.overflow.clear();
+    store.removedCount = 0;
+}
+
+// An implicit lattice has no pending edits to fold in
+void CompactAdjacency(NodeStore& store) {
+    if (store.implicitLattice) return;
+    RebuildAdjacency(store, NodeCount(store), [](int i) { return i; });
+}
+
+// Fold the overflow back into the CSR arrays once it is no longer small next to them.
+// Neighbour queries scan the whole overflow, so it is kept to a fraction of the rows.
+void MaybeCompactAdjacency(NodeStore& store) {
+    size_t added = store.overflow.size();
+    size_t removed = (size_t)store.removedCount;
+    if ((added > 128 && added * 8 > store.targets.size()) ||
+        (removed > 64 && removed * 4 > store.targets.size())) {
+        CompactAdjacency(store);
+    }
+}
+
+void AddEdge(NodeStore& store, int a, int b) {
+    if (a == b) return;
+    MaterializeNodeStore(store);
+    store.overflow.push_back(a);
+    store.overflow.push_back(b);
+    MaybeCompactAdjacency(store);
+}
+
+// Mark one target entry in a CSR row as removed
+void ClearRowEntry(NodeStore& store, int row, int target) {
+    if (row >= CompactedRowCount(store)) return;
+    for (int k = store.offsets[row]; k < store.offsets[row + 1]; k++) {
+        if (store.targets[k] == target) {
+            store.targets[k] = -1;
+            store.removedCount++;
+            return;
+        }
+    }
+}
+
+// Remove one a-b connection, most recently added first
+void RemoveEdge(NodeStore& store, int a, int b) {
+    MaterializeNodeStore(store);
+    for (size_t k = store.overflow.size(); k >= 2; k -= 2) {
+        int u = store.overflow[k - 2], v = store.overflow[k - 1];
+        if ((u == a && v == b) || (u == b && v == a)) {
+            store.overflow.erase(store.overflow.begin() + (k - 2), store.overflow.begin() + k);
+            return;
+        }
+    }
+    
+    ClearRowEntry(store, a, b);
+    ClearRowEntry(store, b, a);
+    MaybeCompactAdjacency(store);
+}
+
+// Place a node in a free slot, or append one if there is none
+int AllocNode(NodeStore& store, Vector3 p) {
+    MaterializeNodeStore(store);
+    if (store.freeSlots.empty()) {
+        PushNode(store, p);
+        return NodeCount(store) - 1;
+    }
+    int slot = store.freeSlots.back();
+    store.freeSlots.pop_back();
+    SetNodePosition(store, slot, p);
+    store.alive[slot] = 1;
+    store.liveCount++;
+    return slot;
+}
+
+// Bring a specific dead slot back to life (undo of a deletion)
+void ReviveNode(NodeStore& store, int slot, Vector3 p) {
+    auto it = std::find(store.freeSlots.rbegin(), store.freeSlots.rend(), slot);
+    if (it == store.freeSlots.rend()) return;
+    store.freeSlots.erase(std::next(it).base());
+    SetNodePosition(store, slot, p);
+    store.alive[slot] = 1;
+    store.liveCount++;
+}
+
+// Drop a node and its connections in O(degree); the slot goes on the free list
+void KillNode(NodeStore& store, int slot) {
+    if (!IsNodeAlive(store, slot)) return;
+    MaterializeNodeStore(store);
+    
+    if (slot < CompactedRowCount(store)) {
+        for (int k = store.offsets[slot]; k < store.offsets[slot + 1]; k++) {
+            int n = store.targets[k];
+            if (n < 0) continue;
+            ClearRowEntry(store, n, slot);
+            store.targets[k] = -1;
+            store.removedCount++;
+        }
+    }
+    size_t kept = 0;
+    for (size_t k = 0; k < store.overflow.size(); k += 2) {
+        if (store.overflow[k] == slot || store.overflow[k + 1] == slot) continue;
+        store.overflow[kept++] = store.overflow[k];
+        store.overflow[kept++] = store.overflow[k + 1];
+    }
+    store.overflow.resize(kept);
+    
+    store.alive[slot] = 0;
+    store.generation[slot]++;
+    store.freeSlots.push_back(slot);
+    store.liveCount--;
+    MaybeCompactAdjacency(store);
+}
+
+// Close the gaps left by dead slots. Dead slots flagged in keep stay as dead
+// slots (something still refers to them); the rest are dropped. Every
+// generation moves past all previous ones so no old handle resolves again.
+// Returns the new slot of each old slot, or -1 for dropped ones.
+std::vector<int> CompactNodeSlots(NodeStore& store, const std::vector<uint8_t>& keep) {
+    MaterializeNodeStore(store);
+    int count = NodeCount(store);
+    std::vector<int> remap(count, -1);
+    uint32_t nextGeneration = 0;
+    int newCount = 0;
+    for (int i = 0; i < count; i++) {
+        nextGeneration = std::max(nextGeneration, store.generation[i] + 1);
+        if (store.alive[i] || (i < (int)keep.size() && keep[i])) remap[i] = newCount++;
+    }
+    
+    RebuildAdjacency(store, newCount, [&](int n) { return remap[n]; });
+    for (int i = 0; i < count; i++) {
+        int n = remap[i];
+        if (n < 0) continue;
+        store.x[n] = store.x[i];
+        store.y[n] = store.y[i];
+        store.z[n] = store.z[i];
+        store.alive[n] = store.alive[i];
+    }
+    store.x.resize(newCount);
+    store.y.resize(newCount);
+    store.z.resize(newCount);
+    store.alive.resize(newCount);
+    store.generation.assign(newCount, nextGeneration);
+    
+    size_t kept = 0;
+    for (int slot : store.freeSlots) {
+        if (remap[slot] >= 0) store.freeSlots[kept++] = remap[slot];
+    }
+    store.freeSlots.resize(kept);
+    return remap;
+}
+
+// Lattice nodes per slab of z layers filled by one thread
+static const int LATTICE_SLAB_NODES = 1 << 16;
+
+// Lattice centred on 'center'; sizes below 1 give an empty lattice
+LatticeParams MakeCenteredLattice(Vector3 center, int sizeX, int sizeY, int sizeZ, Vector3 spacing) {
+    LatticeParams lattice;
+    if (sizeX < 1 || sizeY < 1 || sizeZ < 1) return lattice;
+    lattice.sizeX = sizeX;
+    lattice.sizeY = sizeY;
+    lattice.sizeZ = sizeZ;
+    lattice.origin = {center.x - spacing.x * (sizeX - 1) * 0.5f,
+                      center.y - spacing.y * (sizeY - 1) * 0.5f,
+                      center.z - spacing.z * (sizeZ - 1) * 0.5f};
+    lattice.spacing = spacing;
+    return lattice;
+}
+
+int LatticeNodeCount(const LatticeParams& lattice) {
+    return lattice.sizeX * lattice.sizeY * lattice.sizeZ;
+}
+
+Vector3 LatticeNodePosition(const LatticeParams& lattice, int i) {
+    int x = i % lattice.sizeX, y = (i / lattice.sizeX) % lattice.sizeY, z = i / (lattice.sizeX * lattice.sizeY);
+    return {lattice.origin.x + x * lattice.spacing.x,
+            lattice.origin.y + y * lattice.spacing.y,
+            lattice.origin.z + z * lattice.spacing.z};
+}
+
+BoundingBox LatticeBounds(const LatticeParams& lattice) {
+    int count = LatticeNodeCount(lattice);
+    if (count == 0) return EmptyBounds();
+    Vector3 first = LatticeNodePosition(lattice, 0), last = LatticeNodePosition(lattice, count - 1);
+    return {Vector3Min(first, last), Vector3Max(first, last)};
+}
+
+// Explicit arrays for a lattice, with positions computed exactly as LatticeNodePosition does
+NodeStore BuildLatticeStore(const LatticeParams& lattice) {
+    NodeStore nodes;
+    int sizeX = lattice.sizeX, sizeY = lattice.sizeY, sizeZ = lattice.sizeZ;
+    if (sizeX < 1 || sizeY < 1 || sizeZ < 1) return nodes;
+    int layer = sizeX * sizeY;
+    int count = layer * sizeZ;
+    Vector3 origin = lattice.origin;
+    Vector3 spacing = lattice.spacing;
+    
+    // Every layer has the same connections within it, plus one per node to each
+    // neighbouring layer, so where a layer's CSR rows start is known up front
+    int planeEdges = 2 * ((sizeX - 1) * sizeY + sizeX * (sizeY - 1));
+    auto layerStart = [&](int z) {
+        return z * planeEdges + layer * (std::max(z - 1, 0) + std::min(z, sizeZ - 1));
+    };
+    
+    std::vector<float> xs(count), ys(count), zs(count);
+    std::vector<int> offsets(count + 1), targets(layerStart(sizeZ));
+    offsets[0] = 0;
+    
+    // Slabs of whole layers write disjoint ranges of every array
+    int slabCount = std::max(1, std::min(sizeZ, count / LATTICE_SLAB_NODES));
+    ParallelFor(slabCount, [&](size_t slab) {
+        int firstZ = (int)(sizeZ * slab / slabCount);
+        int endZ = (int)(sizeZ * (slab + 1) / slabCount);
+        for (int z = firstZ; z < endZ; z++) {
+            int edge = layerStart(z);
+            for (int y = 0; y < sizeY; y++) {
+                for (int x = 0; x < sizeX; x++) {
+                    int i = z * layer + y * sizeX + x;
+                    xs[i] = origin.x + x * spacing.x;
+                    ys[i] = origin.y + y * spacing.y;
+                    zs[i] = origin.z + z * spacing.z;
+                    
+                    if (x > 0) targets[edge++] = i - 1;
+                    if (x < sizeX - 1) targets[edge++] = i + 1;
+                    if (y > 0) targets[edge++] = i - sizeX;
+                    if (y < sizeY - 1) targets[edge++] = i + sizeX;
+                    if (z > 0) targets[edge++] = i - layer;
+                    if (z < sizeZ - 1) targets[edge++] = i + layer;
+                    offsets[i + 1] = edge;
+                }
+            }
+        }
+    });
+    
+    nodes.x.swap(xs);
+    nodes.y.swap(ys);
+    nodes.z.swap(zs);
+    nodes.offsets.swap(offsets);
+    nodes.targets.swap(targets);
+    nodes.generation.assign(count, 0);
+    nodes.alive.assign(count, 1);
+    nodes.liveCount = count;
+    return nodes;
+}
+
+NodeStore Create3DGridStructure(Vector3 center, int sizeX, int sizeY, int sizeZ, Vector3 spacing) {
+    return BuildLatticeStore(MakeCenteredLattice(center, sizeX, sizeY, sizeZ, spacing));
+}
+
+NodeStore Create3DGridStructure(Vector3 center, float totalSize, int gridDimension) {
+    float spacing = gridDimension > 1 ? totalSize / (float)(gridDimension - 1) : 0.0f;
+    return Create3DGridStructure(center, gridDimension, gridDimension, gridDimension, {spacing, spacing, spacing});
+}
+
+NodeStore CreateImplicitGrid(Vector3 center, int sizeX, int sizeY, int sizeZ, Vector3 spacing) {
+    NodeStore nodes;
+    nodes.lattice = MakeCenteredLattice(center, sizeX, sizeY, sizeZ, spacing);
+    nodes.implicitLattice = LatticeNodeCount(nodes.lattice) > 0;
+    nodes.liveCount = LatticeNodeCount(nodes.lattice);
+    return nodes;
+}
+
+NodeStore CreateImplicitGrid(Vector3 center, float totalSize, int gridDimension) {
+    float spacing = gridDimension > 1 ? totalSize / (float)(gridDimension - 1) : 0.0f;
+    return CreateImplicitGrid(center, gridDimension, gridDimension, gridDimension, {spacing, spacing, spacing});
+}
+
+// Give an implicit lattice its explicit arrays. Node indices and handles stay
+// valid, so nothing that refers to the nodes has to change.
+void MaterializeNodeStore(NodeStore& store) {
+    if (!store.implicitLattice) return;
+    store = BuildLatticeStore(store.lattice);
+}
+
+void MarkModuleChanged(GridModule& module) {
+    module.revision = NextModuleRevision();
+}
+
+static const float SPATIAL_CELL_SIZE = 4.0f;
+
+// Packs signed cell coordinates into 21 bits per axis
+uint64_t SpatialCellKey(int cx, int cy, int cz) {
+    return ((uint64_t)(cx & 0x1FFFFF) << 42) | ((uint64_t)(cy & 0x1FFFFF) << 21) | (uint64_t)(cz & 0x1FFFFF);
+}
+
+void SpatialCellCoords(const SpatialHash& hash, Vector3 p, int& cx, int& cy, int& cz) {
+    cx = (int)floorf((p.x - hash.origin.x) / SPATIAL_CELL_SIZE);
+    cy = (int)floorf((p.y - hash.origin.y) / SPATIAL_CELL_SIZE);
+    cz = (int)floorf((p.z - hash.origin.z) / SPATIAL_CELL_SIZE);
+}
+
+uint64_t SpatialCellOf(const SpatialHash& hash, Vector3 p) {
+    int cx, cy, cz;
+    SpatialCellCoords(hash, p, cx, cy, cz);
+    return SpatialCellKey(cx, cy, cz);
+}
+
+void SpatialHashInsert(SpatialHash& hash, int nodeIdx, Vector3 p) {
+    uint64_t key = SpatialCellOf(hash, p);
+    if ((int)hash.nodeCell.size() <= nodeIdx) hash.nodeCell.resize(nodeIdx + 1);
+    hash.nodeCell[nodeIdx] = key;
+    hash.cells[key].push_back(nodeIdx);
+}
+
+void SpatialHashErase(SpatialHash& hash, int nodeIdx) {
+    auto it = hash.cells.find(hash.nodeCell[nodeIdx]);
+    if (it == hash.cells.end()) return;
+    
+    std::vector<int>& cell = it->second;
+    auto pos = std::find(cell.begin(), cell.end(), nodeIdx);
+    if (pos != cell.end()) {
+        *pos = cell.back();
+        cell.pop_back();
+    }
+    if (cell.empty()) hash.cells.erase(it);
+}
+
+// An implicit lattice answers proximity queries from its parameters, so its hash stays empty
+void RebuildSpatialHash(GridModule& module) {
+    SpatialHash& hash = module.spatial;
+    hash.cells.clear();
+    hash.origin = {0.0f, 0.0f, 0.0f};
+    hash.nodeCell.assign(module.nodes.implicitLattice ? 0 : NodeCount(module.nodes), 0);
+    for (int i = 0; i < (int)hash.nodeCell.size(); i++) {
+        if (IsNodeAlive(module.nodes, i)) SpatialHashInsert(hash, i, NodePosition(module.nodes, i));
+    }
+    hash.needsRebuild = false;
+}
+
+// Re-bucket a node after its position changed
+void SpatialHashMove(GridModule& module, int nodeIdx) {
+    SpatialHash& hash = module.spatial;
+    if (hash.needsRebuild) return;
+    
+    uint64_t key = SpatialCellOf(hash, NodePosition(module.nodes, nodeIdx));
+    if (key == hash.nodeCell[nodeIdx]) return;
+    SpatialHashErase(hash, nodeIdx);
+    SpatialHashInsert(hash, nodeIdx, NodePosition(module.nodes, nodeIdx));
+}
+
+void SpatialHashRemove(GridModule& module, int nodeIdx) {
+    if (!module.spatial.needsRebuild) SpatialHashErase(module.spatial, nodeIdx);
+}
+
+// Lattice indices along one axis whose coordinate may lie in [lo, hi], one
+// extra on each side so rounding never loses a node; empty when first > last
+void LatticeAxisRange(const LatticeParams& lattice, int axis, float lo, float hi, int& first, int& last) {
+    int size = axis == 0 ? lattice.sizeX : (axis == 1 ? lattice.sizeY : lattice.sizeZ);
+    float origin = AxisValue(lattice.origin, axis), spacing = AxisValue(lattice.spacing, axis);
+    if (spacing == 0.0f) {
+        bool inside = lo <= origin && origin <= hi;
+        first = inside ? 0 : size;
+        last = inside ? size - 1 : -1;
+        return;
+    }
+    float a = (lo - origin) / spacing, b = (hi - origin) / spacing;
+    if (a > b) std::swap(a, b);
+    a = std::min(std::max(a, -1.0f), (float)size);
+    b = std::min(std::max(b, -1.0f), (float)size);
+    first = (int)ceilf(a) - 1;
+    last = (int)floorf(b) + 1;
+    first = std::max(first, 0);
+    last = std::min(last, size - 1);
+}
+
+// Calls fn(nodeIdx, distance) for every node within radius of center
+template <typename Fn>
+void ForEachNodeInRadius(const GridModule& module, Vector3 center, float radius, Fn fn) {
+    if (module.nodes.implicitLattice) {
+        const LatticeParams& lattice = module.nodes.lattice;
+        int x0, y0, z0, x1, y1, z1;
+        LatticeAxisRange(lattice, 0, center.x - radius, center.x + radius, x0, x1);
+        LatticeAxisRange(lattice, 1, center.y - radius, center.y + radius, y0, y1);
+        LatticeAxisRange(lattice, 2, center.z - radius, center.z + radius, z0, z1);
+        for (int z = z0; z <= z1; z++) {
+            for (int y = y0; y <= y1; y++) {
+                for (int x = x0; x <= x1; x++) {
+                    int idx = (z * lattice.sizeY + y) * lattice.sizeX + x;
+                    float dist = Vector3Distance(center, LatticeNodePosition(lattice, idx));
+                    if (dist <= radius) fn(idx, dist);
+                }
+            }
+        }
+        return;
+    }
+    
+    const SpatialHash& hash = module.spatial;
+    int x0, y0, z0, x1, y1, z1;
+    SpatialCellCoords(hash, Vector3SubtractValue(center, radius), x0, y0, z0);
+    SpatialCellCoords(hash, Vector3AddValue(center, radius), x1, y1, z1);
+    double cellCount = (double)(x1 - x0 + 1) * (y1 - y0 + 1) * (z1 - z0 + 1);
+    
+    // Stale hash, or a radius so large that visiting cells costs more than a scan
+    if (hash.needsRebuild || cellCount > (double)NodeCount(module.nodes)) {
+        for (int i = 0; i < NodeCount(module.nodes); i++) {
+            if (!IsNodeAlive(module.nodes, i)) continue;
+            float dist = Vector3Distance(center, NodePosition(module.nodes, i));
+            if (dist <= radius) fn(i, dist);
+        }
+        return;
+    }
+    
+    for (int z = z0; z <= z1; z++) {
+        for (int y = y0; y <= y1; y++) {
+            for (int x = x0; x <= x1; x++) {
+                auto it = hash.cells.find(SpatialCellKey(x, y, z));
+                if (it == hash.cells.end()) continue;
+                for (int idx : it->second) {
+                    float dist = Vector3Distance(center, NodePosition(module.nodes, idx));
+                    if (dist <= radius) fn(idx, dist);
+                }
+            }
+        }
+    }
+}
+
+// Nearest node within maxDist of p, searching rings of cells outward, or -1
+int FindNearestNode(const GridModule& module, Vector3 p, float maxDist, float* outDist) {
+    const SpatialHash& hash = module.spatial;
+    int closestNode = -1;
+    float closestDist = FLT_MAX;
+    
+    if (module.nodes.implicitLattice) {
+        // Distance separates by axis, so the nearest lattice node is the nearest index on each
+        const LatticeParams& lattice = module.nodes.lattice;
+        int size[3] = {lattice.sizeX, lattice.sizeY, lattice.sizeZ};
+        int cell[3];
+        for (int axis = 0; axis < 3; axis++) {
+            float spacing = AxisValue(lattice.spacing, axis);
+            float index = spacing != 0.0f ? roundf((AxisValue(p, axis) - AxisValue(lattice.origin, axis)) / spacing) : 0.0f;
+            cell[axis] = (int)std::min(std::max(index, 0.0f), (float)(size[axis] - 1));
+        }
+        int idx = (cell[2] * lattice.sizeY + cell[1]) * lattice.sizeX + cell[0];
+        float dist = Vector3Distance(p, LatticeNodePosition(lattice, idx));
+        if (dist <= maxDist) {
+            closestDist = dist;
+            closestNode = idx;
+        }
+    } else if (hash.needsRebuild) {
+        for (int i = 0; i < NodeCount(module.nodes); i++) {
+            if (!IsNodeAlive(module.nodes, i)) continue;
+            float dist = Vector3Distance(p, NodePosition(module.nodes, i));
+            if (dist <= maxDist && dist < closestDist) {
+                closestDist = dist;
+                closestNode = i;
+            }
+        }
+    } else {
+        int cx, cy, cz;
+        SpatialCellCoords(hash, p, cx, cy, cz);
+        int maxRing = (int)ceilf(maxDist / SPATIAL_CELL_SIZE) + 1;
+        
+        for (int r = 0; r <= maxRing; r++) {
+            // Nodes in ring r are at least (r - 1) cells away from p
+            float ringDist = (r - 1) * SPATIAL_CELL_SIZE;
+            if (ringDist > maxDist || ringDist >= closestDist) break;
+            
+            for (int dz = -r; dz <= r; dz++) {
+                for (int dy = -r; dy <= r; dy++) {
+                    // Inside the shell only the two x faces belong to this ring
+                    int step = (r > 0 && abs(dz) < r && abs(dy) < r) ? 2 * r : 1;
+                    for (int dx = -r; dx <= r; dx += step) {
+                        auto it = hash.cells.find(SpatialCellKey(cx + dx, cy + dy, cz + dz));
+                        if (it == hash.cells.end()) continue;
+                        for (int idx : it->second) {
+                            float dist = Vector3Distance(p, NodePosition(module.nodes, idx));
+                            if (dist <= maxDist && dist < closestDist) {
+                                closestDist = dist;
+                                closestNode = idx;
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    }
+    
+    if (outDist != nullptr) *outDist = closestDist;
+    return closestNode;
+}
+
+// Wall leaves hold one AVX2 batch of triangles for IntersectRayTriangles
+static const int WALL_BVH_LEAF_SIZE = 8;
+
+BoundingBox EmptyBounds() {
+    return {{FLT_MAX, FLT_MAX, FLT_MAX}, {-FLT_MAX, -FLT_MAX, -FLT_MAX}};
+}
+
+bool IsEmptyBounds(const BoundingBox& box) {
+    return box.min.x > box.max.x;
+}
+
+BoundingBox MergeBounds(const BoundingBox& a, const BoundingBox& b) {
+    return {Vector3Min(a.min, b.min), Vector3Max(a.max, b.max)};
+}
+
+BoundingBox PointBounds(Vector3 p) {
+    return {p, p};
+}
+
+BoundingBox TriangleBounds(Vector3 a, Vector3 b, Vector3 c) {
+    return {Vector3Min(a, Vector3Min(b, c)), Vector3Max(a, Vector3Max(b, c))};
+}
+
+float AxisValue(Vector3 v, int axis) {
+    return axis == 0 ? v.x : (axis == 1 ? v.y : v.z);
+}
+
+int BuildBVHRange(BVH& bvh, const std::vector<BoundingBox>& primBounds, const std::vector<Vector3>& centroids,
+                  int first, int count, int parent, int leafSize) {
+    int nodeIdx = (int)bvh.nodes.size();
+    bvh.nodes.push_back({EmptyBounds(), -1, -1, first, count});
+    bvh.parent.push_back(parent);
+    
+    BoundingBox bounds = EmptyBounds();
+    BoundingBox centroidBounds = EmptyBounds();
+    for (int i = first; i < first + count; i++) {
+        bounds = MergeBounds(bounds, primBounds[bvh.prims[i]]);
+        centroidBounds = MergeBounds(centroidBounds, PointBounds(centroids[bvh.prims[i]]));
+    }
+    bvh.nodes[nodeIdx].bounds = bounds;
+    
+    Vector3 extent = Vector3Subtract(centroidBounds.max, centroidBounds.min);
+    if (count <= leafSize || (extent.x <= 0.0f && extent.y <= 0.0f && extent.z <= 0.0f)) {
+        for (int i = first; i < first + count; i++) {
+            bvh.primLeaf[bvh.prims[i]] = nodeIdx;
+        }
+        return nodeIdx;
+    }
+    
+    // Median split along the longest centroid axis keeps the depth at log2(n)
+    int axis = (extent.x >= extent.y && extent.x >= extent.z) ? 0 : (extent.y >= extent.z ? 1 : 2);
+    int mid = first + count / 2;
+    std::nth_element(bvh.prims.begin() + first, bvh.prims.begin() + mid, bvh.prims.begin() + first + count,
+        [&](int a, int b) { return AxisValue(centroids[a], axis) < AxisValue(centroids[b], axis); });
+    
+    int left = BuildBVHRange(bvh, primBounds, centroids, first, mid - first, nodeIdx, leafSize);
+    int right = BuildBVHRange(bvh, primBounds, centroids, mid, first + count - mid, nodeIdx, leafSize);
+    bvh.nodes[nodeIdx].left = left;
+    bvh.nodes[nodeIdx].right = right;
+    bvh.nodes[nodeIdx].count = 0;
+    return nodeIdx;
+}
+
+void BuildBVH(BVH& bvh, const std::vector<BoundingBox>& primBounds, int leafSize) {
+    int primCount = (int)primBounds.size();
+    bvh.nodes.clear();
+    bvh.parent.clear();
+    bvh.prims.resize(primCount);
+    bvh.primLeaf.assign(primCount, -1);
+    if (primCount == 0) return;
+    
+    std::vector<Vector3> centroids(primCount);
+    for (int i = 0; i < primCount; i++) {
+        bvh.prims[i] = i;
+        centroids[i] = IsEmptyBounds(primBounds[i]) ? Vector3{0.0f, 0.0f, 0.0f}
+                                                    : Vector3Scale(Vector3Add(primBounds[i].min, primBounds[i].max), 0.5f);
+    }
+    bvh.nodes.reserve(2 * (primCount / leafSize + 1));
+    BuildBVHRange(bvh, primBounds, centroids, 0, primCount, -1, leafSize);
+}
+
+template <typename BoundsFn>
+void RefitBVHNode(BVH& bvh, int nodeIdx, BoundsFn primBounds) {
+    BVHNode& node = bvh.nodes[nodeIdx];
+    if (node.left < 0) {
+        node.bounds = EmptyBounds();
+        for (int i = node.first; i < node.first + node.count; i++) {
+            node.bounds = MergeBounds(node.bounds, primBounds(bvh.prims[i]));
+        }
+    } else {
+        node.bounds = MergeBounds(bvh.nodes[node.left].bounds, bvh.nodes[node.right].bounds);
+    }
+}
+
+// Bottom-up refit of every node, keeps the topology
+template <typename BoundsFn>
+void RefitBVH(BVH& bvh, BoundsFn primBounds) {
+    for (int n = (int)bvh.nodes.size() - 1; n >= 0; n--) {
+        RefitBVHNode(bvh, n, primBounds);
+    }
+}
+
+// Refit only the path from one primitive's leaf to the root
+template <typename BoundsFn>
+void RefitBVHPrimitive(BVH& bvh, int prim, BoundsFn primBounds) {
+    if (prim < 0 || prim >= (int)bvh.primLeaf.size()) return;
+    for (int n = bvh.primLeaf[prim]; n >= 0; n = bvh.parent[n]) {
+        RefitBVHNode(bvh, n, primBounds);
+    }
+}
+
+void TranslateBVH(BVH& bvh, Vector3 delta) {
+    for (auto& node : bvh.nodes) {
+        if (IsEmptyBounds(node.bounds)) continue;
+        node.bounds.min = Vector3Add(node.bounds.min, delta);
+        node.bounds.max = Vector3Add(node.bounds.max, delta);
+    }
+}
+
+// Slab test against a box grown by 'inflate'; rejects boxes behind the ray or beyond maxDist
+bool RayHitsBounds(const Ray& ray, Vector3 invDir, const BoundingBox& box, float inflate, float maxDist, float* entry) {
+    if (IsEmptyBounds(box)) return false;
+    
+    float tx1 = (box.min.x - inflate - ray.position.x) * invDir.x;
+    float tx2 = (box.max.x + inflate - ray.position.x) * invDir.x;
+    float ty1 = (box.min.y - inflate - ray.position.y) * invDir.y;
+    float ty2 = (box.max.y + inflate - ray.position.y) * invDir.y;
+    float tz1 = (box.min.z - inflate - ray.position.z) * invDir.z;
+    float tz2 = (box.max.z + inflate - ray.position.z) * invDir.z;
+    
+    float tmin = fmaxf(fmaxf(fminf(tx1, tx2), fminf(ty1, ty2)), fminf(tz1, tz2));
+    float tmax = fminf(fminf(fmaxf(tx1, tx2), fmaxf(ty1, ty2)), fmaxf(tz1, tz2));
+    if (tmax < 0.0f || tmin > tmax || tmin > maxDist) return false;
+    
+    *entry = tmin;
+    return true;
+}
+
+// Visits leaves front to back, skipping subtrees farther than closestDist.
+// testLeaf(first, count) gets the leaf's range of bvh.prims and must lower
+// closestDist when it records a closer hit.
+template <typename LeafFn>
+void TraverseBVHLeaves(const BVH& bvh, const Ray& ray, float inflate, const float& closestDist, LeafFn testLeaf) {
+    if (bvh.nodes.empty()) return;
+    
+    Vector3 invDir = {1.0f / ray.direction.x, 1.0f / ray.direction.y, 1.0f / ray.direction.z};
+    struct StackEntry { int node; float entry; };
+    StackEntry stack[64];
+    int stackSize = 0;
+    
+    float rootEntry;
+    if (!RayHitsBounds(ray, invDir, bvh.nodes[0].bounds, inflate, closestDist, &rootEntry)) return;
+    stack[stackSize++] = {0, rootEntry};
+    
+    while (stackSize > 0) {
+        StackEntry top = stack[--stackSize];
+        if (top.entry > closestDist) continue;
+        
+        const BVHNode& node = bvh.nodes[top.node];
+        if (node.left < 0) {
+            testLeaf(node.first, node.count);
+            continue;
+        }
+        
+        float leftEntry, rightEntry;
+        bool hitLeft = RayHitsBounds(ray, invDir, bvh.nodes[node.left].bounds, inflate, closestDist, &leftEntry);
+        bool hitRight = RayHitsBounds(ray, invDir, bvh.nodes[node.right].bounds, inflate, closestDist, &rightEntry);
+        
+        // Push the farther child first so the nearer one is visited first
+        if (hitLeft && hitRight) {
+            if (leftEntry < rightEntry) {
+                stack[stackSize++] = {node.right, rightEntry};
+                stack[stackSize++] = {node.left, leftEntry};
+            } else {
+                stack[stackSize++] = {node.left, leftEntry};
+                stack[stackSize++] = {node.right, rightEntry};
+            }
+        } else if (hitLeft) {
+            stack[stackSize++] = {node.left, leftEntry};
+        } else if (hitRight) {
+            stack[stackSize++] = {node.right, rightEntry};
+        }
+    }
+}
+
+// As TraverseBVHLeaves, calling testPrim(prim) for each primitive of a leaf
+template <typename PrimFn>
+void TraverseBVH(const BVH& bvh, const Ray& ray, float inflate, const float& closestDist, PrimFn testPrim) {
+    TraverseBVHLeaves(bvh, ray, inflate, closestDist, [&](int first, int count) {
+        for (int i = first; i < first + count; i++) testPrim(bvh.prims[i]);
+    });
+}
+
+BoundingBox GetWallTriangleBounds(const GridModule& module, const WallTriangle& tri) {
+    const Wall& wall = module.walls[tri.wall];
+    return TriangleBounds(NodePosition(module.nodes, wall.nodeIndices[0]),
+                          NodePosition(module.nodes, wall.nodeIndices[tri.corner]),
+                          NodePosition(module.nodes, wall.nodeIndices[tri.corner + 1]));
+}
+
+// Copy wall triangle corners into the packed buffer, in wall tree leaf order
+void UpdateWallTrianglePack(GridModule& module) {
+    ModulePickBVH& pick = module.pick;
+    ResizeTrianglePack(pick.packed, (int)pick.wallTree.prims.size());
+    for (size_t j = 0; j < pick.wallTree.prims.size(); j++) {
+        const WallTriangle& tri = pick.triangles[pick.wallTree.prims[j]];
+        const Wall& wall = module.walls[tri.wall];
+        SetPackedTriangle(pick.packed, (int)j, NodePosition(module.nodes, wall.nodeIndices[0]),
+                          NodePosition(module.nodes, wall.nodeIndices[tri.corner]),
+                          NodePosition(module.nodes, wall.nodeIndices[tri.corner + 1]));
+    }
+}
+
+BoundingBox GetModuleBounds(const GridModule& module) {
+    if (module.pick.needsRebuild) return EmptyBounds();
+    if (module.nodes.implicitLattice) return LatticeBounds(module.nodes.lattice);
+    if (module.pick.nodeTree.nodes.empty()) return EmptyBounds();
+    return module.pick.nodeTree.nodes[0].bounds;
+}
+
+// Dead slots keep a leaf with empty bounds so the slot can be revived with a refit
+BoundingBox GetNodeBounds(const GridModule& module, int i) {
+    return IsNodeAlive(module.nodes, i) ? PointBounds(NodePosition(module.nodes, i)) : EmptyBounds();
+}
+
+// Implicit lattices get no node tree; their nodes are found from the lattice parameters
+void RebuildModulePicking(GridModule& module) {
+    ModulePickBVH& pick = module.pick;
+    std::vector<BoundingBox> bounds(module.nodes.implicitLattice ? 0 : NodeCount(module.nodes));
+    for (int i = 0; i < (int)bounds.size(); i++) {
+        bounds[i] = GetNodeBounds(module, i);
+    }
+    BuildBVH(pick.nodeTree, bounds);
+    
+    // Fan-triangulate walls the same way DrawWall does
+    pick.triangles.clear();
+    bounds.clear();
+    int nodeCount = NodeCount(module.nodes);
+    for (size_t w = 0; w < module.walls.size(); w++) {
+        const std::vector<int>& idx = module.walls[w].nodeIndices;
+        bool valid = idx.size() >= 3;
+        for (int n : idx) {
+            if (n < 0 || n >= nodeCount) valid = false;
+        }
+        if (!valid) continue;
+        
+        for (size_t i = 1; i < idx.size() - 1; i++) {
+            WallTriangle tri = {(int)w, (int)i};
+            pick.triangles.push_back(tri);
+            bounds.push_back(GetWallTriangleBounds(module, tri));
+        }
+    }
+    BuildBVH(pick.wallTree, bounds, WALL_BVH_LEAF_SIZE);
+    UpdateWallTrianglePack(module);
+    
+    pick.needsRebuild = false;
+    pick.wallsNeedRefit = false;
+    pick.boundsChanged = true;
+}
+
+void InvalidateModulePicking(GridModule& module) {
+    module.pick.needsRebuild = true;
+}
+
+void InvalidateScenePicking(ScenePickBVH& scene) {
+    scene.moduleIds.clear();
+}
+
+// Called before the first edit of a module's nodes. Picking and the spatial
+// hash of an implicit lattice have nothing to update in place, so both rebuild.
+void MaterializeModuleNodes(GridModule& module) {
+    if (!module.nodes.implicitLattice) return;
+    MaterializeNodeStore(module.nodes);
+    module.spatial.needsRebuild = true;
+    InvalidateModulePicking(module);
+}
+
+// Move a single node and refit the path above it instead of rebuilding
+void MoveNode(GridModule& module, int nodeIdx, Vector3 position) {
+    if (!IsNodeAlive(module.nodes, nodeIdx)) return;
+    MaterializeModuleNodes(module);
+    SetNodePosition(module.nodes, nodeIdx, position);
+    SpatialHashMove(module, nodeIdx);
+    MarkModuleChanged(module);
+    
+    ModulePickBVH& pick = module.pick;
+    if (pick.needsRebuild) return;
+    RefitBVHPrimitive(pick.nodeTree, nodeIdx, [&](int i) { return GetNodeBounds(module, i); });
+    if (!pick.triangles.empty()) pick.wallsNeedRefit = true;
+    pick.boundsChanged = true;
+}
+
+// Translate every node of a module; the trees are shifted rather than refit
+void TranslateModule(GridModule& module, Vector3 delta) {
+    NodeStore& nodes = module.nodes;
+    if (nodes.implicitLattice) nodes.lattice.origin = Vector3Add(nodes.lattice.origin, delta);
+    for (size_t i = 0; i < nodes.x.size(); i++) nodes.x[i] += delta.x;
+    for (size_t i = 0; i < nodes.y.size(); i++) nodes.y[i] += delta.y;
+    for (size_t i = 0; i < nodes.z.size(); i++) nodes.z[i] += delta.z;
+    module.center = Vector3Add(module.center, delta);
+    module.spatial.origin = Vector3Add(module.spatial.origin, delta);
+    MarkModuleChanged(module);
+    
+    ModulePickBVH& pick = module.pick;
+    if (pick.needsRebuild) return;
+    TranslateBVH(pick.nodeTree, delta);
+    TranslateBVH(pick.wallTree, delta);
+    UpdateWallTrianglePack(module);
+    pick.boundsChanged = true;
+}
+
+// Bring every module tree, spatial hash and the scene tree up to date.
+// Call once per frame before picking or proximity queries.
+void UpdateScenePicking(std::vector<GridModule>& modules, ScenePickBVH& scene) {
+    bool rebuildScene = scene.moduleIds.size() != modules.size();
+    
+    for (size_t m = 0; m < modules.size(); m++) {
+        GridModule& module = modules[m];
+        if (!rebuildScene && scene.moduleIds[m] != module.id) rebuildScene = true;
+        if (module.paged) continue;
+        
+        if (module.spatial.needsRebuild) RebuildSpatialHash(module);
+        if (module.pick.needsRebuild) {
+            RebuildModulePicking(module);
+        } else if (module.pick.wallsNeedRefit) {
+            RefitBVH(module.pick.wallTree, [&](int t) { return GetWallTriangleBounds(module, module.pick.triangles[t]); });
+            UpdateWallTrianglePack(module);
+            module.pick.wallsNeedRefit = false;
+        }
+    }
+    
+    if (rebuildScene) {
+        std::vector<BoundingBox> bounds(modules.size());
+        scene.moduleIds.resize(modules.size());
+        for (size_t m = 0; m < modules.size(); m++) {
+            bounds[m] = GetModuleBounds(modules[m]);
+            scene.moduleIds[m] = modules[m].id;
+            modules[m].pick.boundsChanged = false;
+        }
+        BuildBVH(scene.tree, bounds);
+        return;
+    }
+    
+    for (size_t m = 0; m < modules.size(); m++) {
+        if (!modules[m].pick.boundsChanged) continue;
+        RefitBVHPrimitive(scene.tree, (int)m, [&](int i) { return GetModuleBounds(modules[i]); });
+        modules[m].pick.boundsChanged = false;
+    }
+}
+
+// Plane through 'point' facing along 'normal', scaled to unit length
+Vector4 MakeFrustumPlane(Vector3 normal, Vector3 point) {
+    float length = Vector3Length(normal);
+    normal = Vector3Scale(normal, 1.0f / length);
+    return {normal.x, normal.y, normal.z, -Vector3DotProduct(normal, point)};
+}
+
+// Frustum of a raylib camera; aspect is viewport width over height
+Frustum MakeCameraFrustum(const Camera3D& camera, float aspect, float nearPlane, float farPlane) {
+    Vector3 forward = Vector3Normalize(Vector3Subtract(camera.target, camera.position));
+    Vector3 right = Vector3Normalize(Vector3CrossProduct(forward, camera.up));
+    Vector3 up = Vector3CrossProduct(right, forward);
+    Vector3 eye = camera.position;
+    
+    Frustum frustum;
+    frustum.planes[0] = MakeFrustumPlane(forward, Vector3Add(eye, Vector3Scale(forward, nearPlane)));
+    frustum.planes[1] = MakeFrustumPlane(Vector3Negate(forward), Vector3Add(eye, Vector3Scale(forward, farPlane)));
+    if (camera.projection == CAMERA_ORTHOGRAPHIC) {
+        // fovy is the height of the view volume
+        float halfHeight = camera.fovy * 0.5f;
+        float halfWidth = halfHeight * aspect;
+        frustum.planes[2] = MakeFrustumPlane(right, Vector3Subtract(eye, Vector3Scale(right, halfWidth)));
+        frustum.planes[3] = MakeFrustumPlane(Vector3Negate(right), Vector3Add(eye, Vector3Scale(right, halfWidth)));
+        frustum.planes[4] = MakeFrustumPlane(up, Vector3Subtract(eye, Vector3Scale(up, halfHeight)));
+        frustum.planes[5] = MakeFrustumPlane(Vector3Negate(up), Vector3Add(eye, Vector3Scale(up, halfHeight)));
+    } else {
+        // Side planes pass through the eye; each normal leans towards the view direction
+        float halfHeight = tanf(camera.fovy * DEG2RAD * 0.5f);
+        float halfWidth = halfHeight * aspect;
+        frustum.planes[2] = MakeFrustumPlane(Vector3Add(right, Vector3Scale(forward, halfWidth)), eye);
+        frustum.planes[3] = MakeFrustumPlane(Vector3Add(Vector3Negate(right), Vector3Scale(forward, halfWidth)), eye);
+        frustum.planes[4] = MakeFrustumPlane(Vector3Add(up, Vector3Scale(forward, halfHeight)), eye);
+        frustum.planes[5] = MakeFrustumPlane(Vector3Add(Vector3Negate(up), Vector3Scale(forward, halfHeight)), eye);
+    }
+    return frustum;
+}
+
+// Conservative: a box near a frustum corner can be reported as intersecting
+// while lying just outside, never the other way round
+FrustumTest TestFrustumBounds(const Frustum& frustum, const BoundingBox& bounds, float inflate) {
+    if (IsEmptyBounds(bounds)) return FRUSTUM_OUTSIDE;
+    
+    FrustumTest result = FRUSTUM_INSIDE;
+    for (const Vector4& plane : frustum.planes) {
+        // Corner farthest along the plane normal, and the one farthest against it
+        Vector3 farCorner = {plane.x >= 0.0f ? bounds.max.x : bounds.min.x,
+                             plane.y >= 0.0f ? bounds.max.y : bounds.min.y,
+                             plane.z >= 0.0f ? bounds.max.z : bounds.min.z};
+        Vector3 nearCorner = {plane.x >= 0.0f ? bounds.min.x : bounds.max.x,
+                              plane.y >= 0.0f ? bounds.min.y : bounds.max.y,
+                              plane.z >= 0.0f ? bounds.min.z : bounds.max.z};
+        if (plane.x * farCorner.x + plane.y * farCorner.y + plane.z * farCorner.z + plane.w < -inflate) return FRUSTUM_OUTSIDE;
+        if (plane.x * nearCorner.x + plane.y * nearCorner.y + plane.z * nearCorner.z + plane.w < inflate) result = FRUSTUM_INTERSECTS;
+    }
+    return result;
+}
+
+// Screen pixels covered by one world unit at 'position', for sizing detail levels
+float PixelsPerUnit(const Camera3D& camera, float viewportHeight, Vector3 position) {
+    if (camera.projection == CAMERA_ORTHOGRAPHIC) return viewportHeight / camera.fovy;
+    float distance = std::max(Vector3Distance(camera.position, position), 1e-4f);
+    return viewportHeight / (2.0f * tanf(camera.fovy * DEG2RAD * 0.5f) * distance);
+}
+
+// Closest lattice node sphere hit nearer than closestDist, or -1. Walks the
+// cells around each node that the ray crosses (Amanatides-Woo) and tests the
+// nodes close enough for their sphere to reach into the cell, stopping once a
+// cell starts beyond the closest hit.
+int PickLatticeNode(const LatticeParams& lattice, const Ray& ray, float sphereRadius, float& closestDist) {
+    int size[3] = {lattice.sizeX, lattice.sizeY, lattice.sizeZ};
+    float origin[3], spacing[3], start[3], direction[3];
+    int reach[3];
+    bool regular = true;
+    for (int axis = 0; axis < 3; axis++) {
+        origin[axis] = AxisValue(lattice.origin, axis);
+        spacing[axis] = AxisValue(lattice.spacing, axis);
+        start[axis] = AxisValue(ray.position, axis);
+        direction[axis] = AxisValue(ray.direction, axis);
+        // A single layer can take any cell size that holds the whole sphere
+        if (size[axis] == 1 && spacing[axis] <= 0.0f) spacing[axis] = std::max(2.0f * sphereRadius, 1.0f);
+        if (spacing[axis] <= 0.0f) regular = false;
+        else reach[axis] = (int)floorf(sphereRadius / spacing[axis] + 0.5f);
+    }
+    
+    int closestNode = -1;
+    auto testNode = [&](int i) {
+        Vector3 p = LatticeNodePosition(lattice, i);
+        float t = RaySphereDistance(ray, p.x, p.y, p.z, sphereRadius);
+        if (t >= 0.0f && t < closestDist) {
+            closestDist = t;
+            closestNode = i;
+        }
+    };
+    if (!regular) {
+        // Collapsed or mirrored axes have no cells to walk
+        for (int i = 0; i < LatticeNodeCount(lattice); i++) testNode(i);
+        return closestNode;
+    }
+    
+    // Cell c along an axis spans origin + (c -/+ 0.5) * spacing. Cells out to
+    // 'reach' beyond the lattice can still hold part of a boundary sphere.
+    float enter = 0.0f, exit = closestDist;
+    for (int axis = 0; axis < 3; axis++) {
+        float lo = origin[axis] - (reach[axis] + 0.5f) * spacing[axis];
+        float hi = origin[axis] + (size[axis] - 1 + reach[axis] + 0.5f) * spacing[axis];
+        if (direction[axis] == 0.0f) {
+            if (start[axis] < lo || start[axis] > hi) return -1;
+            continue;
+        }
+        float t0 = (lo - start[axis]) / direction[axis], t1 = (hi - start[axis]) / direction[axis];
+        if (t0 > t1) std::swap(t0, t1);
+        enter = std::max(enter, t0);
+        exit = std::min(exit, t1);
+    }
+    if (enter > exit) return -1;
+    
+    int cell[3], step[3];
+    float next[3], delta[3];
+    for (int axis = 0; axis < 3; axis++) {
+        float at = (start[axis] + direction[axis] * enter - origin[axis]) / spacing[axis];
+        cell[axis] = (int)floorf(at + 0.5f);
+        cell[axis] = std::min(std::max(cell[axis], -reach[axis]), size[axis] - 1 + reach[axis]);
+        step[axis] = direction[axis] > 0.0f ? 1 : (direction[axis] < 0.0f ? -1 : 0);
+        if (step[axis] == 0) {
+            next[axis] = delta[axis] = FLT_MAX;
+            continue;
+        }
+        float boundary = origin[axis] + (cell[axis] + 0.5f * step[axis]) * spacing[axis];
+        next[axis] = (boundary - start[axis]) / direction[axis];
+        delta[axis] = spacing[axis] / fabsf(direction[axis]);
+    }
+    
+    float cellEnter = enter;
+    while (cellEnter <= closestDist) {
+        int x0 = std::max(cell[0] - reach[0], 0), x1 = std::min(cell[0] + reach[0], size[0] - 1);
+        int y0 = std::max(cell[1] - reach[1], 0), y1 = std::min(cell[1] + reach[1], size[1] - 1);
+        int z0 = std::max(cell[2] - reach[2], 0), z1 = std::min(cell[2] + reach[2], size[2] - 1);
+        for (int z = z0; z <= z1; z++) {
+            for (int y = y0; y <= y1; y++) {
+                for (int x = x0; x <= x1; x++) testNode((z * size[1] + y) * size[0] + x);
+            }
+        }
+        
+        int axis = next[0] < next[1] ? (next[0] < next[2] ? 0 : 2) : (next[1] < next[2] ? 1 : 2);
+        if (next[axis] > exit) break;
+        cellEnter = next[axis];
+        cell[axis] += step[axis];
+        if (cell[axis] < -reach[axis] || cell[axis] > size[axis] - 1 + reach[axis]) break;
+        next[axis] += delta[axis];
+    }
+    return closestNode;
+}
+
+// Closest node sphere hit nearer than closestDist, or -1. Lowers closestDist on a hit.
+int PickNodeInModule(const GridModule& module, const Ray& ray, float sphereRadius, float& closestDist) {
+    const NodeStore& nodes = module.nodes;
+    if (nodes.implicitLattice) return PickLatticeNode(nodes.lattice, ray, sphereRadius, closestDist);
+    if (module.pick.needsRebuild) {
+        // Tree not built yet (edited this frame), fall back to testing every node in batches
+        RayHit hit = IntersectRaySpheres(ray, nodes.x.data(), nodes.y.data(), nodes.z.data(), nodes.alive.data(),
+                                         NodeCount(nodes), sphereRadius, closestDist);
+        if (hit.index != -1) closestDist = hit.distance;
+        return hit.index;
+    }
+    
+    int closestNode = -1;
+    TraverseBVH(module.pick.nodeTree, ray, sphereRadius, closestDist, [&](int i) {
+        if (!IsNodeAlive(nodes, i)) return;
+        float t = RaySphereDistance(ray, nodes.x[i], nodes.y[i], nodes.z[i], sphereRadius);
+        if (t >= 0.0f && t < closestDist) {
+            closestDist = t;
+            closestNode = i;
+        }
+    });
+    return closestNode;
+}
+
+int GetNodeUnderRay(const GridModule& module, const Ray& ray, float sphereRadius) {
+    float closestDist = FLT_MAX;
+    return PickNodeInModule(module, ray, sphereRadius, closestDist);
+}
+
+int GetModuleUnderRay(const std::vector<GridModule>& modules, const ScenePickBVH& scene, const Ray& ray, float sphereRadius) {
+    int closestModule = -1;
+    float closestDist = FLT_MAX;
+    
+    if (scene.moduleIds.size() != modules.size()) {
+        for (size_t m = 0; m < modules.size(); m++) {
+            if (modules[m].paged) continue;
+            if (PickNodeInModule(modules[m], ray, sphereRadius, closestDist) != -1) closestModule = (int)m;
+        }
+        return closestModule;
+    }
+    
+    TraverseBVH(scene.tree, ray, sphereRadius, closestDist, [&](int m) {
+        if (modules[m].paged) return;
+        if (PickNodeInModule(modules[m], ray, sphereRadius, closestDist) != -1) closestModule = m;
+    });
+    return closestModule;
+}
+
+int GetWallUnderRay(const GridModule& module, const Ray& ray) {
+    const ModulePickBVH& pick = module.pick;
+    if (pick.needsRebuild) {
+        // No packed triangles yet, fan-triangulate each wall in place
+        int closestWall = -1;
+        float closestDist = FLT_MAX;
+        for (size_t w = 0; w < module.walls.size(); w++) {
+            const Wall& wall = module.walls[w];
+            for (size_t i = 1; i + 1 < wall.nodeIndices.size(); i++) {
+                float t = RayTriangleDistance(ray, NodePosition(module.nodes, wall.nodeIndices[0]),
+                                              NodePosition(module.nodes, wall.nodeIndices[i]),
+                                              NodePosition(module.nodes, wall.nodeIndices[i + 1]));
+                if (t >= 0.0f && t < closestDist) {
+                    closestDist = t;
+                    closestWall = (int)w;
+                }
+            }
+        }
+        return closestWall;
+    }
+    
+    // Leaves are contiguous runs of the packed buffer, so each is one kernel call
+    int closestTriangle = -1;
+    float closestDist = FLT_MAX;
+    TraverseBVHLeaves(pick.wallTree, ray, 0.0f, closestDist, [&](int first, int count) {
+        RayHit hit = IntersectRayTriangles(ray, pick.packed, first, count, closestDist);
+        if (hit.index != -1) {
+            closestDist = hit.distance;
+            closestTriangle = hit.index;
+        }
+    });
+    return closestTriangle != -1 ? pick.triangles[pick.wallTree.prims[closestTriangle]].wall : -1;
+}
+
+// Calls fn(prim) for every leaf primitive whose bounds lie within radius of center
+template <typename PrimFn>
+void QueryBVHSphere(const BVH& bvh, Vector3 center, const float& radius, PrimFn fn) {
+    if (bvh.nodes.empty()) return;
+    
+    int stack[64];
+    int stackSize = 0;
+    stack[stackSize++] = 0;
+    while (stackSize > 0) {
+        const BVHNode& node = bvh.nodes[stack[--stackSize]];
+        if (IsEmptyBounds(node.bounds)) continue;
+        
+        Vector3 outside = Vector3Max(Vector3Subtract(node.bounds.min, center), Vector3Subtract(center, node.bounds.max));
+        outside = Vector3Max(outside, {0.0f, 0.0f, 0.0f});
+        if (Vector3Length(outside) > radius) continue;
+        
+        if (node.left < 0) {
+            for (int i = node.first; i < node.first + node.count; i++) fn(bvh.prims[i]);
+        } else {
+            stack[stackSize++] = node.right;
+            stack[stackSize++] = node.left;
+        }
+    }
+}
+
+// Module owning the node closest to position, considering nodes within maxDist only
+int FindClosestModule(const std::vector<GridModule>& modules, const ScenePickBVH& scene, Vector3 position, float maxDist) {
+    int closestModule = -1;
+    float searchRadius = maxDist;
+    auto testModule = [&](int m) {
+        float dist;
+        if (modules[m].paged) return;
+        if (FindNearestNode(modules[m], position, searchRadius, &dist) == -1) return;
+        if (closestModule == -1 || dist < searchRadius) {
+            searchRadius = dist;
+            closestModule = m;
+        }
+    };
+    
+    if (scene.moduleIds.size() != modules.size()) {
+        for (size_t m = 0; m < modules.size(); m++) testModule((int)m);
+    } else {
+        QueryBVHSphere(scene.tree, position, searchRadius, testModule);
+    }
+    return closestModule;
+}
+
+void ConnectNodeToNearby(GridModule& module, int newNodeIndex, float connectionDistance) {
+    if (!IsNodeAlive(module.nodes, newNodeIndex)) return;
+    MaterializeModuleNodes(module);
+    
+    Vector3 position = NodePosition(module.nodes, newNodeIndex);
+    ForEachNodeInRadius(module, position, connectionDistance, [&](int i, float) {
+        if (i == newNodeIndex) return;
+        
+        // Check if connection already exists
+        if (!HasEdge(module.nodes, newNodeIndex, i)) AddEdge(module.nodes, newNodeIndex, i);
+    });
+}
+
+uint64_t NodeRefKey(NodeRef ref) {
+    return ((uint64_t)(uint32_t)ref.moduleId << 32) | (uint32_t)ref.node;
+}
+
+bool SameNodeRef(NodeRef a, NodeRef b) {
+    return a.moduleId == b.moduleId && a.node == b.node;
+}
+
+// Swap-erase one occurrence of value; drops the map entry once its list is empty
+template <typename Map, typename Key>
+void EraseEdgeIndex(Map& map, const Key& key, int value) {
+    auto it = map.find(key);
+    if (it == map.end()) return;
+    std::vector<int>& list = it->second;
+    auto pos = std::find(list.begin(), list.end(), value);
+    if (pos != list.end()) {
+        *pos = list.back();
+        list.pop_back();
+    }
+    if (list.empty()) map.erase(it);
+}
+
+// Returns the edge index, or -1 when both ends are in the same module
+int AddCrossEdge(SceneGraph& graph, NodeRef a, NodeRef b) {
+    if (a.moduleId == b.moduleId) return -1;
+    
+    int e;
+    if (graph.freeEdges.empty()) {
+        e = (int)graph.edges.size();
+        graph.edges.push_back({a, b});
+    } else {
+        e = graph.freeEdges.back();
+        graph.freeEdges.pop_back();
+        graph.edges[e] = {a, b};
+    }
+    graph.nodeEdges[NodeRefKey(a)].push_back(e);
+    graph.nodeEdges[NodeRefKey(b)].push_back(e);
+    graph.moduleEdges[a.moduleId].push_back(e);
+    graph.moduleEdges[b.moduleId].push_back(e);
+    graph.edgeCount++;
+    return e;
+}
+
+void RemoveCrossEdge(SceneGraph& graph, int e) {
+    CrossEdge& edge = graph.edges[e];
+    if (edge.a.moduleId < 0) return;
+    EraseEdgeIndex(graph.nodeEdges, NodeRefKey(edge.a), e);
+    EraseEdgeIndex(graph.nodeEdges, NodeRefKey(edge.b), e);
+    EraseEdgeIndex(graph.moduleEdges, edge.a.moduleId, e);
+    EraseEdgeIndex(graph.moduleEdges, edge.b.moduleId, e);
+    edge.a.moduleId = edge.b.moduleId = -1;
+    graph.freeEdges.push_back(e);
+    graph.edgeCount--;
+}
+
+// Calls fn(edgeIndex, otherEnd) for every cross-module connection of a node
+template <typename Fn>
+void ForEachCrossEdgeAt(const SceneGraph& graph, NodeRef ref, Fn fn) {
+    auto it = graph.nodeEdges.find(NodeRefKey(ref));
+    if (it == graph.nodeEdges.end()) return;
+    for (int e : it->second) {
+        const CrossEdge& edge = graph.edges[e];
+        fn(e, SameNodeRef(edge.a, ref) ? edge.b : edge.a);
+    }
+}
+
+int FindCrossEdge(const SceneGraph& graph, NodeRef a, NodeRef b) {
+    int found = -1;
+    ForEachCrossEdgeAt(graph, a, [&](int e, NodeRef other) {
+        if (found == -1 && SameNodeRef(other, b)) found = e;
+    });
+    return found;
+}
+
+// Remove every cross-module connection of a node, optionally recording them
+void RemoveNodeCrossEdges(SceneGraph& graph, NodeRef ref, std::vector<CrossEdge>* removed) {
+    auto it = graph.nodeEdges.find(NodeRefKey(ref));
+    if (it == graph.nodeEdges.end()) return;
+    std::vector<int> edges = it->second;
+    for (int e : edges) {
+        if (removed != nullptr) removed->push_back(graph.edges[e]);
+        RemoveCrossEdge(graph, e);
+    }
+}
+
+// Remove every cross-module connection touching a module, in time proportional to their number
+void RemoveModuleCrossEdges(SceneGraph& graph, int moduleId, std::vector<CrossEdge>* removed) {
+    auto it = graph.moduleEdges.find(moduleId);
+    if (it == graph.moduleEdges.end()) return;
+    std::vector<int> edges = it->second;
+    for (int e : edges) {
+        if (removed != nullptr) removed->push_back(graph.edges[e]);
+        RemoveCrossEdge(graph, e);
+    }
+}
+
+// Renumber a module's node slots (after compaction) in its cross-module connections
+void RemapModuleCrossEdges(SceneGraph& graph, int moduleId, const std::vector<int>& remap) {
+    std::vector<CrossEdge> edges;
+    RemoveModuleCrossEdges(graph, moduleId, &edges);
+    for (auto& edge : edges) {
+        if (edge.a.moduleId == moduleId) edge.a.node = remap[edge.a.node];
+        if (edge.b.moduleId == moduleId) edge.b.node = remap[edge.b.node];
+        AddCrossEdge(graph, edge.a, edge.b);
+    }
+}
+
+void ConnectNodeToNearbyAcrossModules(std::vector<GridModule>& modules, SceneGraph& graph, const ScenePickBVH& scene,
+                                      int targetModuleIndex, int newNodeIndex, float connectionDistance) {
+    if (targetModuleIndex < 0 || targetModuleIndex >= (int)modules.size()) return;
+    GridModule& target = modules[targetModuleIndex];
+    if (!IsNodeAlive(target.nodes, newNodeIndex)) return;
+    
+    ConnectNodeToNearby(target, newNodeIndex, connectionDistance);
+    
+    // Nodes of other modules go into the scene graph
+    NodeRef from = {target.id, newNodeIndex};
+    Vector3 position = NodePosition(target.nodes, newNodeIndex);
+    auto connectModule = [&](int m) {
+        if (m == targetModuleIndex || modules[m].paged) return;
+        ForEachNodeInRadius(modules[m], position, connectionDistance, [&](int i, float) {
+            NodeRef to = {modules[m].id, i};
+            if (FindCrossEdge(graph, from, to) == -1) AddCrossEdge(graph, from, to);
+        });
+    };
+    
+    if (scene.moduleIds.size() != modules.size()) {
+        for (size_t m = 0; m < modules.size(); m++) connectModule((int)m);
+    } else {
+        QueryBVHSphere(scene.tree, position, connectionDistance, connectModule);
+    }
+}
+
+bool AreNodesCoplanar(const NodeStore& nodes, const std::vector<int>& indices) {
+    if (indices.size() < 3) return false;
+    if (indices.size() == 3) return true; // Triangles are always coplanar
+    
+    // For 4+ points, check if they're on the same plane
+    Vector3 p1 = NodePosition(nodes, indices[0]);
+    Vector3 p2 = NodePosition(nodes, indices[1]);
+    Vector3 p3 = NodePosition(nodes, indices[2]);
+    
+    Vector3 v1 = Vector3Subtract(p2, p1);
+    Vector3 v2 = Vector3Subtract(p3, p1);
+    Vector3 normal = Vector3Normalize(Vector3CrossProduct(v1, v2));
+    
+    // Check if all other points lie on the same plane
+    for (size_t i = 3; i < indices.size(); i++) {
+        Vector3 v3 = Vector3Subtract(NodePosition(nodes, indices[i]), p1);
+        float dot = fabs(Vector3DotProduct(normal, v3));
+        if (dot > 1.0f) return false; // Not coplanar
+    }
+    
+    return true;
+}
+
+bool FormValidPolygon(const NodeStore& nodes, const std::vector<int>& indices) {
+    // Any number of points can form a polygon as long as they're coplanar
+    return indices.size() >= 3;
+}
+
+unsigned int NewWallId() {
+    static unsigned int nextWallId = 1;
+    return nextWallId++;
+}
+
+// Walls with the same nodes in any order share a key
+uint64_t WallShapeKey(std::vector<int> nodes) {
+    std::sort(nodes.begin(), nodes.end());
+    uint64_t key = 14695981039346656037ull;
+    for (int n : nodes) {
+        key ^= (uint32_t)n;
+        key *= 1099511628211ull;
+    }
+    return key;
+}
+
+void IndexWall(WallIndex& index, const std::vector<Wall>& walls, int w) {
+    index.byShape.emplace(WallShapeKey(walls[w].nodeIndices), w);
+    for (int n : walls[w].nodeIndices) index.byNode[n].push_back(w);
+}
+
+void UnindexWall(WallIndex& index, const std::vector<Wall>& walls, int w) {
+    auto range = index.byShape.equal_range(WallShapeKey(walls[w].nodeIndices));
+    for (auto it = range.first; it != range.second; ++it) {
+        if (it->second == w) {
+            index.byShape.erase(it);
+            break;
+        }
+    }
+    for (int n : walls[w].nodeIndices) {
+        auto it = index.byNode.find(n);
+        if (it == index.byNode.end()) continue;
+        std::vector<int>& nodeWalls = it->second;
+        auto found = std::find(nodeWalls.begin(), nodeWalls.end(), w);
+        if (found != nodeWalls.end()) {
+            *found = nodeWalls.back();
+            nodeWalls.pop_back();
+        }
+        if (nodeWalls.empty()) index.byNode.erase(it);
+    }
+}
+
+WallIndex& ModuleWallIndex(GridModule& module) {
+    WallIndex& index = module.wallIndex;
+    if (index.needsRebuild || index.wallCount != module.walls.size()) {
+        index.byShape.clear();
+        index.byNode.clear();
+        for (int w = 0; w < (int)module.walls.size(); w++) IndexWall(index, module.walls, w);
+        index.wallCount = module.walls.size();
+        index.needsRebuild = false;
+    }
+    return index;
+}
+
+// Walls that have nodeIdx as a corner, in no particular order
+const std::vector<int>& WallsUsingNode(GridModule& module, int nodeIdx) {
+    static const std::vector<int> none;
+    WallIndex& index = ModuleWallIndex(module);
+    auto it = index.byNode.find(nodeIdx);
+    return it != index.byNode.end() ? it->second : none;
+}
+
+// Walls DeleteNode removes, highest position first. Removing them in this order
+// never moves one of the others, so each position is still valid when its turn comes.
+std::vector<int> WallsToRemoveWithNode(GridModule& module, int nodeIdx) {
+    std::vector<int> walls = WallsUsingNode(module, nodeIdx);
+    std::sort(walls.begin(), walls.end(), std::greater<int>());
+    walls.erase(std::unique(walls.begin(), walls.end()), walls.end());
+    return walls;
+}
+
+bool CreateWallFromSelectedNodes(GridModule& module, const std::vector<int>& selected) {
+    if (selected.size() < 3) return false; // Need at least 3 nodes for a triangle
+    for (int idx : selected) {
+        if (!IsNodeAlive(module.nodes, idx)) return false;
+    }
+    if (!AreNodesCoplanar(module.nodes, selected)) return false;
+    
+    // Check if wall with these exact nodes already exists; a key match is confirmed
+    // against the nodes themselves in case two shapes share a hash
+    WallIndex& index = ModuleWallIndex(module);
+    std::vector<int> sortedSelected = selected;
+    std::sort(sortedSelected.begin(), sortedSelected.end());
+    auto range = index.byShape.equal_range(WallShapeKey(sortedSelected));
+    for (auto it = range.first; it != range.second; ++it) {
+        std::vector<int> wallNodes = module.walls[it->second].nodeIndices;
+        std::sort(wallNodes.begin(), wallNodes.end());
+        if (wallNodes == sortedSelected) {
+            return false; // Wall already exists
+        }
+    }
+    
+    Wall newWall;
+    newWall.nodeIndices = selected;
+    newWall.id = NewWallId();
+    InsertWall(module, (int)module.walls.size(), newWall);
+    return true;
+}
+
+// Update picking for a slot that was just filled or emptied. Slots the node
+// tree already covers are refit in place; a new slot needs a rebuild.
+void RefitNodeSlot(GridModule& module, int nodeIdx) {
+    ModulePickBVH& pick = module.pick;
+    if (pick.needsRebuild) return;
+    if (nodeIdx >= (int)pick.nodeTree.primLeaf.size()) {
+        InvalidateModulePicking(module);
+        return;
+    }
+    RefitBVHPrimitive(pick.nodeTree, nodeIdx, [&](int i) { return GetNodeBounds(module, i); });
+    pick.boundsChanged = true;
+}
+
+int AddNode(GridModule& module, Vector3 position) {
+    MaterializeModuleNodes(module);
+    int nodeIdx = AllocNode(module.nodes, position);
+    if (!module.spatial.needsRebuild) SpatialHashInsert(module.spatial, nodeIdx, position);
+    RefitNodeSlot(module, nodeIdx);
+    MarkModuleChanged(module);
+    return nodeIdx;
+}
+
+// Other node indices are unaffected; the slot is reused by a later AddNode
+void DeleteNode(GridModule& module, int nodeIdx) {
+    if (!IsNodeAlive(module.nodes, nodeIdx)) return;
+    MaterializeModuleNodes(module);
+    
+    SpatialHashRemove(module, nodeIdx);
+    KillNode(module.nodes, nodeIdx);
+    
+    // Remove walls that contain this node
+    std::vector<int> incident = WallsToRemoveWithNode(module, nodeIdx);
+    for (int w : incident) RemoveWall(module, w);
+    
+    if (incident.empty()) RefitNodeSlot(module, nodeIdx);
+    MarkModuleChanged(module);
+}
+
+// Module ids only ever grow and modules keep their relative order, so the list is sorted by id
+int FindModuleIndex(const std::vector<GridModule>& modules, int moduleId) {
+    auto it = std::lower_bound(modules.begin(), modules.end(), moduleId,
+        [](const GridModule& module, int id) { return module.id < id; });
+    if (it != modules.end() && it->id == moduleId) return (int)(it - modules.begin());
+    return -1;
+}
+
+// Inverse of RemoveWall: the wall now at wallIdx moves back to the end
+void InsertWall(GridModule& module, int wallIdx, const Wall& wall) {
+    WallIndex& index = ModuleWallIndex(module);
+    std::vector<Wall>& walls = module.walls;
+    if (wallIdx < (int)walls.size()) {
+        UnindexWall(index, walls, wallIdx);
+        Wall displaced = std::move(walls[wallIdx]);
+        walls[wallIdx] = wall;
+        walls.push_back(std::move(displaced));
+        IndexWall(index, walls, (int)walls.size() - 1);
+    } else {
+        walls.push_back(wall);
+    }
+    IndexWall(index, walls, wallIdx);
+    index.wallCount = walls.size();
+    InvalidateModulePicking(module);
+    MarkModuleChanged(module);
+}
+
+// Removes a wall by moving the last wall into its place
+void RemoveWall(GridModule& module, int wallIdx) {
+    WallIndex& index = ModuleWallIndex(module);
+    std::vector<Wall>& walls = module.walls;
+    int last = (int)walls.size() - 1;
+    UnindexWall(index, walls, wallIdx);
+    if (wallIdx != last) {
+        UnindexWall(index, walls, last);
+        walls[wallIdx] = std::move(walls[last]);
+        IndexWall(index, walls, wallIdx);
+    }
+    walls.pop_back();
+    index.wallCount = walls.size();
+    InvalidateModulePicking(module);
+    MarkModuleChanged(module);
+}
+
+// Inverse of DeleteNode: revive the same slot and restore its connections
+void RestoreNode(GridModule& module, int nodeIdx, Vector3 position, const std::vector<int>& neighbors) {
+    MaterializeModuleNodes(module);
+    ReviveNode(module.nodes, nodeIdx, position);
+    for (int n : neighbors) AddEdge(module.nodes, nodeIdx, n);
+    if (!module.spatial.needsRebuild) SpatialHashInsert(module.spatial, nodeIdx, position);
+    RefitNodeSlot(module, nodeIdx);
+    MarkModuleChanged(module);
+}
+
+// Remember everything DeleteNode is about to drop so it can be put back
+void CaptureNodeDeletion(GridModule& module, EditCommand& cmd) {
+    cmd.removedPosition = NodePosition(module.nodes, cmd.node);
+    cmd.neighbors.clear();
+    ForEachNeighbor(module.nodes, cmd.node, [&](int n) { cmd.neighbors.push_back(n); });
+    cmd.walls.clear();
+    for (int w : WallsToRemoveWithNode(module, cmd.node)) cmd.walls.push_back({w, module.walls[w]});
+}
+
+// Apply a command forwards (first time or redo)
+bool ApplyEdit(EditCommand& cmd, std::vector<GridModule>& modules, SceneGraph& graph, int& nextModuleId) {
+    if (cmd.type == EDIT_ADD_MODULE) {
+        cmd.moduleIndex = std::min(cmd.moduleIndex < 0 ? (int)modules.size() : cmd.moduleIndex, (int)modules.size());
+        modules.insert(modules.begin() + cmd.moduleIndex, std::move(*cmd.module));
+        cmd.module.reset();
+        nextModuleId = cmd.nextModuleIdAfter;
+        return true;
+    }
+    
+    int m = FindModuleIndex(modules, cmd.moduleId);
+    if (m == -1) return false;
+    GridModule& module = modules[m];
+    
+    switch (cmd.type) {
+        case EDIT_ADD_NODE:
+            // A redo puts the node back in the slot later journal entries refer to
+            if (cmd.node >= 0) RestoreNode(module, cmd.node, cmd.to, {});
+            else cmd.node = AddNode(module, cmd.to);
+            break;
+        case EDIT_DELETE_NODE:
+            CaptureNodeDeletion(module, cmd);
+            cmd.crossEdges.clear();
+            RemoveNodeCrossEdges(graph, {cmd.moduleId, cmd.node}, &cmd.crossEdges);
+            DeleteNode(module, cmd.node);
+            break;
+        case EDIT_MOVE_NODE:
+            MoveNode(module, cmd.node, cmd.to);
+            break;
+        case EDIT_MOVE_MODULE:
+            TranslateModule(module, cmd.to);
+            break;
+        case EDIT_CONNECT:
+            if (cmd.otherModuleId >= 0) {
+                AddCrossEdge(graph, {cmd.moduleId, cmd.node}, {cmd.otherModuleId, cmd.otherNode});
+            } else {
+                MaterializeModuleNodes(module);
+                AddEdge(module.nodes, cmd.node, cmd.otherNode);
+            }
+            break;
+        case EDIT_CREATE_WALL:
+            InsertWall(module, cmd.wall, cmd.walls[0].wall);
+            cmd.walls.clear();
+            break;
+        case EDIT_DELETE_WALL:
+            cmd.walls.assign(1, {cmd.wall, module.walls[cmd.wall]});
+            RemoveWall(module, cmd.wall);
+            break;
+        case EDIT_SET_TEXTURE:
+            cmd.oldTexture = module.walls[cmd.wall].texture;
+            module.walls[cmd.wall].texture = cmd.newTexture;
+            MarkModuleChanged(module);
+            break;
+        case EDIT_DELETE_MODULE:
+            cmd.crossEdges.clear();
+            RemoveModuleCrossEdges(graph, cmd.moduleId, &cmd.crossEdges);
+            cmd.moduleIndex = m;
+            cmd.module.reset(new GridModule(std::move(module)));
+            modules.erase(modules.begin() + m);
+            break;
+        default:
+            break;
+    }
+    return true;
+}
+
+// Apply a command backwards
+bool RevertEdit(EditCommand& cmd, std::vector<GridModule>& modules, SceneGraph& graph, int& nextModuleId) {
+    if (cmd.type == EDIT_DELETE_MODULE) {
+        int index = std::min(cmd.moduleIndex, (int)modules.size());
+        modules.insert(modules.begin() + index, std::move(*cmd.module));
+        cmd.module.reset();
+        for (const auto& edge : cmd.crossEdges) AddCrossEdge(graph, edge.a, edge.b);
+        cmd.crossEdges.clear();
+        return true;
+    }
+    
+    int m = FindModuleIndex(modules, cmd.moduleId);
+    if (m == -1) return false;
+    GridModule& module = modules[m];
+    
+    switch (cmd.type) {
+        case EDIT_ADD_NODE:
+            DeleteNode(module, cmd.node);
+            break;
+        case EDIT_DELETE_NODE:
+            RestoreNode(module, cmd.node, cmd.removedPosition, cmd.neighbors);
+            for (auto it = cmd.walls.rbegin(); it != cmd.walls.rend(); ++it) {
+                InsertWall(module, it->index, it->wall);
+            }
+            for (const auto& edge : cmd.crossEdges) AddCrossEdge(graph, edge.a, edge.b);
+            cmd.walls.clear();
+            cmd.crossEdges.clear();
+            break;
+        case EDIT_MOVE_NODE:
+            MoveNode(module, cmd.node, cmd.from);
+            break;
+        case EDIT_MOVE_MODULE:
+            TranslateModule(module, Vector3Negate(cmd.to));
+            break;
+        case EDIT_CONNECT:
+            if (cmd.otherModuleId >= 0) {
+                int e = FindCrossEdge(graph, {cmd.moduleId, cmd.node}, {cmd.otherModuleId, cmd.otherNode});
+                if (e != -1) RemoveCrossEdge(graph, e);
+            } else {
+                MaterializeModuleNodes(module);
+                RemoveEdge(module.nodes, cmd.node, cmd.otherNode);
+            }
+            break;
+        case EDIT_CREATE_WALL:
+            cmd.walls.assign(1, {cmd.wall, module.walls[cmd.wall]});
+            RemoveWall(module, cmd.wall);
+            break;
+        case EDIT_DELETE_WALL:
+            InsertWall(module, cmd.walls[0].index, cmd.walls[0].wall);
+            cmd.walls.clear();
+            break;
+        case EDIT_SET_TEXTURE:
+            module.walls[cmd.wall].texture = cmd.oldTexture;
+            MarkModuleChanged(module);
+            break;
+        case EDIT_ADD_MODULE:
+            cmd.moduleIndex = m;
+            cmd.module.reset(new GridModule(std::move(module)));
+            modules.erase(modules.begin() + m);
+            nextModuleId = cmd.nextModuleIdBefore;
+            break;
+        default:
+            break;
+    }
+    return true;
+}
+
+// Record an edit that has already been applied to the scene. Textures held only
+// by dropped commands become unused and are left to the texture cache.
+void RecordEdit(EditJournal& journal, EditCommand&& cmd) {
+    journal.redoStack.clear();
+    
+    journal.undoStack.push_back(std::move(cmd));
+    while (journal.undoStack.size() > journal.maxHistory) {
+        journal.undoStack.pop_front();
+    }
+}
+
+// Forget all history
+void ClearJournal(EditJournal& journal) {
+    journal.redoStack.clear();
+    journal.undoStack.clear();
+}
+
+// Apply an edit and record it
+bool PerformEdit(EditJournal& journal, std::vector<GridModule>& modules, SceneGraph& graph, int& nextModuleId, EditCommand&& cmd) {
+    if (!ApplyEdit(cmd, modules, graph, nextModuleId)) return false;
+    RecordEdit(journal, std::move(cmd));
+    return true;
+}
+
+bool UndoEdit(EditJournal& journal, std::vector<GridModule>& modules, SceneGraph& graph, int& nextModuleId) {
+    if (journal.undoStack.empty()) return false;
+    EditCommand cmd = std::move(journal.undoStack.back());
+    journal.undoStack.pop_back();
+    if (!RevertEdit(cmd, modules, graph, nextModuleId)) return false;
+    journal.redoStack.push_back(std::move(cmd));
+    return true;
+}
+
+bool RedoEdit(EditJournal& journal, std::vector<GridModule>& modules, SceneGraph& graph, int& nextModuleId) {
+    if (journal.redoStack.empty()) return false;
+    EditCommand cmd = std::move(journal.redoStack.back());
+    journal.redoStack.pop_back();
+    if (!ApplyEdit(cmd, modules, graph, nextModuleId)) return false;
+    journal.undoStack.push_back(std::move(cmd));
+    return true;
+}
+
+EditCommand MakeEdit(EditType type, int moduleId) {
+    EditCommand cmd;
+    cmd.type = type;
+    cmd.moduleId = moduleId;
+    return cmd;
+}
+
+// Calls fn(slot) on every node slot of moduleId that a journal entry refers to
+template <typename Fn>
+void ForEachJournalNodeRef(EditJournal& journal, int moduleId, Fn fn) {
+    auto visit = [&](EditCommand& cmd) {
+        for (auto& edge : cmd.crossEdges) {
+            if (edge.a.moduleId == moduleId) fn(edge.a.node);
+            if (edge.b.moduleId == moduleId) fn(edge.b.node);
+        }
+        int otherModuleId = cmd.otherModuleId >= 0 ? cmd.otherModuleId : cmd.moduleId;
+        if (otherModuleId == moduleId && cmd.otherNode >= 0) fn(cmd.otherNode);
+        if (cmd.moduleId != moduleId) return;
+        if (cmd.node >= 0) fn(cmd.node);
+        for (int& n : cmd.neighbors) fn(n);
+        for (auto& removed : cmd.walls) {
+            for (int& idx : removed.wall.nodeIndices) fn(idx);
+        }
+    };
+    for (auto& cmd : journal.undoStack) visit(cmd);
+    for (auto& cmd : journal.redoStack) visit(cmd);
+}
+
+bool ModuleNeedsCompaction(const GridModule& module) {
+    int dead = NodeCount(module.nodes) - module.nodes.liveCount;
+    return dead > 64 && dead * 4 > NodeCount(module.nodes);
+}
+
+// Close the dead node slots of a module. Slots the journal can still revive
+// are kept and renumbered along with every index the journal holds.
+// Node indices and handles held elsewhere are invalid afterwards.
+void CompactModuleNodes(GridModule& module, SceneGraph& graph, EditJournal& journal) {
+    if (module.nodes.liveCount == NodeCount(module.nodes)) return;
+    
+    std::vector<uint8_t> keep(NodeCount(module.nodes), 0);
+    ForEachJournalNodeRef(journal, module.id, [&](int& slot) { keep[slot] = 1; });
+    std::vector<int> remap = CompactNodeSlots(module.nodes, keep);
+    
+    for (auto& wall : module.walls) {
+        for (auto& idx : wall.nodeIndices) idx = remap[idx];
+    }
+    module.wallIndex.needsRebuild = true;
+    ForEachJournalNodeRef(journal, module.id, [&](int& slot) { slot = remap[slot]; });
+    RemapModuleCrossEdges(graph, module.id, remap);
+    
+    module.spatial.needsRebuild = true;
+    InvalidateModulePicking(module);
+    MarkModuleChanged(module);
+}
+
+// FNV-1a; only has to tell images apart, not resist collisions on purpose
+uint64_t HashTextureBytes(const void* data, size_t size, uint64_t hash = 14695981039346656037ull) {
+    const unsigned char* bytes = (const unsigned char*)data;
+    for (size_t i = 0; i < size; i++) {
+        hash ^= bytes[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+size_t TextureGpuBytes(Texture2D texture) {
+    size_t bytes = 0;
+    int width = texture.width, height = texture.height;
+    for (int level = 0; level < std::max(texture.mipmaps, 1); level++) {
+        bytes += (size_t)GetPixelDataSize(width, height, texture.format);
+        width = std::max(width / 2, 1);
+        height = std::max(height / 2, 1);
+    }
+    return bytes;
+}
+
+std::shared_ptr<TextureAsset> AddTextureAsset(TextureCache& cache, Texture2D texture, const std::string& path, uint64_t hash) {
+    auto asset = std::make_shared<TextureAsset>();
+    asset->texture = texture;
+    asset->path = path;
+    asset->contentHash = hash;
+    asset->gpuBytes = TextureGpuBytes(texture);
+    asset->lastUsed = cache.tick;
+    cache.assets.push_back(asset);
+    cache.byHash[hash] = asset;
+    cache.residentBytes += asset->gpuBytes;
+    return asset;
+}
+
+// Worker side: file bytes to a decoded image with mipmaps, no larger than maxSize
+void DecodeTextureFile(const std::string& path, int maxSize, DecodedTexture& result) {
+    int size = 0;
+    unsigned char* bytes = LoadFileData(path.c_str(), &size);
+    if (!bytes) return;
+    result.contentHash = HashTextureBytes(bytes, size);
+    result.image = LoadImageFromMemory(GetFileExtension(path.c_str()), bytes, size);
+    UnloadFileData(bytes);
+    if (!result.image.data) return;
+    
+    int largest = std::max(result.image.width, result.image.height);
+    if (largest > maxSize) {
+        ImageResize(&result.image, std::max(result.image.width * maxSize / largest, 1),
+                    std::max(result.image.height * maxSize / largest, 1));
+    }
+    GenImageMipmaps(&result.image);
+}
+
+void RunTextureLoader(TextureLoader& loader) {
+    for (;;) {
+        TextureLoadJob job;
+        {
+            std::unique_lock<std::mutex> lock(loader.mutex);
+            loader.wake.wait(lock, [&]() { return loader.stopping || !loader.jobs.empty(); });
+            if (loader.stopping) return;
+            job = std::move(loader.jobs.front());
+            loader.jobs.pop_front();
+        }
+        
+        DecodedTexture result;
+        result.asset = std::move(job.asset);
+        DecodeTextureFile(job.path, job.maxSize, result);
+        
+        std::lock_guard<std::mutex> lock(loader.mutex);
+        loader.decoded.push_back(std::move(result));
+    }
+}
+
+TextureLoader::~TextureLoader() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    if (worker.joinable()) worker.join();
+    for (auto& result : decoded) {
+        if (result.image.data) UnloadImage(result.image);
+    }
+}
+
+// Texture for an image file, decoded on the loader thread. Walls can use the
+// returned asset at once; it shows the placeholder until UploadDecodedTextures
+// has uploaded it. Unchanged files already requested return the same asset.
+// Returns null when the file does not exist.
+std::shared_ptr<TextureAsset> RequestTexture(TextureCache& cache, const std::string& path) {
+    if (path.empty() || !FileExists(path.c_str())) return nullptr;
+    
+    long modTime = GetFileModTime(path.c_str());
+    auto known = cache.byPath.find(path);
+    if (known != cache.byPath.end() && known->second.modTime == modTime) {
+        if (auto asset = known->second.asset.lock()) {
+            asset->lastUsed = cache.tick;
+            return asset;
+        }
+    }
+    
+    if (cache.placeholder.id == 0) {
+        Image image = GenImageChecked(64, 64, 8, 8, GRAY, DARKGRAY);
+        cache.placeholder = LoadTextureFromImage(image);
+        UnloadImage(image);
+    }
+    if (!cache.loader) {
+        cache.loader.reset(new TextureLoader());
+        cache.loader->worker = std::thread(RunTextureLoader, std::ref(*cache.loader));
+    }
+    
+    auto asset = std::make_shared<TextureAsset>();
+    asset->texture = cache.placeholder;
+    asset->path = path;
+    asset->lastUsed = cache.tick;
+    asset->loading = true;
+    cache.assets.push_back(asset);
+    cache.byPath[path] = {asset, modTime};
+    {
+        std::lock_guard<std::mutex> lock(cache.loader->mutex);
+        cache.loader->jobs.push_back({asset, path, cache.maxTextureSize});
+    }
+    cache.loader->wake.notify_one();
+    return asset;
+}
+
+// Main side: uploads a decoded image into its asset, or points the asset at an
+// identical image that is already loaded. Files that failed to decode get the default blue.
+void FinishTextureLoad(TextureCache& cache, DecodedTexture& result) {
+    TextureAsset& asset = *result.asset;
+    asset.loading = false;
+    asset.contentHash = result.contentHash;
+    
+    std::shared_ptr<TextureAsset> same;
+    auto found = cache.byHash.find(result.contentHash);
+    if (result.image.data && found != cache.byHash.end()) same = found->second.lock();
+    if (same && !same->loading) {
+        UnloadImage(result.image);
+        asset.sharedWith = same;
+        asset.texture = same->texture;
+        return;
+    }
+    
+    Texture2D texture = {};
+    if (result.image.data) {
+        texture = LoadTextureFromImage(result.image);
+        UnloadImage(result.image);
+    }
+    if (texture.id == 0) {
+        printf("Failed to load texture from file: %s\n", asset.path.c_str());
+        asset.sharedWith = AcquireSolidTexture(cache, BLUE, 256, 256);
+        asset.texture = asset.sharedWith->texture;
+        return;
+    }
+    if (texture.mipmaps > 1) SetTextureFilter(texture, TEXTURE_FILTER_TRILINEAR);
+    
+    asset.texture = texture;
+    asset.gpuBytes = TextureGpuBytes(texture);
+    cache.residentBytes += asset.gpuBytes;
+    cache.byHash[result.contentHash] = result.asset;
+}
+
+// Call once per frame: uploads decoded textures until budgetMs has passed,
+// always at least one so loading keeps moving. Returns how many were uploaded.
+int UploadDecodedTextures(TextureCache& cache, double budgetMs) {
+    if (!cache.loader) return 0;
+    
+    auto start = std::chrono::steady_clock::now();
+    int uploaded = 0;
+    for (;;) {
+        DecodedTexture result;
+        {
+            std::lock_guard<std::mutex> lock(cache.loader->mutex);
+            if (cache.loader->decoded.empty()) break;
+            result = std::move(cache.loader->decoded.front());
+            cache.loader->decoded.erase(cache.loader->decoded.begin());
+        }
+        FinishTextureLoad(cache, result);
+        uploaded++;
+        
+        std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+        if (elapsed.count() >= budgetMs) break;
+    }
+    return uploaded;
+}
+
+int TexturesLoading(const TextureCache& cache) {
+    int count = 0;
+    for (const auto& asset : cache.assets) {
+        if (asset->loading) count++;
+    }
+    return count;
+}
+
+// Generated single-colour texture, shared by every wall asking for the same one
+std::shared_ptr<TextureAsset> AcquireSolidTexture(TextureCache& cache, Color color, int width, int height) {
+    int params[6] = {width, height, color.r, color.g, color.b, color.a};
+    uint64_t hash = HashTextureBytes("solid", 5);
+    hash = HashTextureBytes(params, sizeof(params), hash);
+    
+    auto same = cache.byHash.find(hash);
+    if (same != cache.byHash.end()) {
+        if (auto asset = same->second.lock()) {
+            asset->lastUsed = cache.tick;
+            return asset;
+        }
+    }
+    
+    Image image = GenImageColor(width, height, color);
+    Texture2D texture = LoadTextureFromImage(image);
+    UnloadImage(image);
+    std::shared_ptr<TextureAsset> asset = AddTextureAsset(cache, texture, "", hash);
+    TrimTextureCache(cache);
+    return asset;
+}
+
+// Call once per frame: marks textures walls still use, then unloads the least
+// recently used unreferenced ones while the cache is over budget
+void TrimTextureCache(TextureCache& cache) {
+    cache.tick++;
+    for (const auto& asset : cache.assets) {
+        if (asset.use_count() > 1) asset->lastUsed = cache.tick;
+    }
+    
+    bool evicted = false;
+    while (cache.residentBytes > cache.budgetBytes) {
+        int oldest = -1;
+        for (int i = 0; i < (int)cache.assets.size(); i++) {
+            const auto& asset = cache.assets[i];
+            if (asset.use_count() > 1 || asset->loading) continue;
+            if (oldest == -1 || asset->lastUsed < cache.assets[oldest]->lastUsed) oldest = i;
+        }
+        if (oldest == -1) break; // Everything resident is in use
+        
+        const TextureAsset& asset = *cache.assets[oldest];
+        cache.residentBytes -= asset.gpuBytes;
+        if (!asset.sharedWith) UnloadTexture(asset.texture);
+        cache.assets.erase(cache.assets.begin() + oldest);
+        evicted = true;
+    }
+    if (!evicted) return;
+    
+    // Drop lookups of the unloaded assets
+    for (auto it = cache.byPath.begin(); it != cache.byPath.end();) {
+        it = it->second.asset.expired() ? cache.byPath.erase(it) : std::next(it);
+    }
+    for (auto it = cache.byHash.begin(); it != cache.byHash.end();) {
+        it = it->second.expired() ? cache.byHash.erase(it) : std::next(it);
+    }
+}
+
+// Stops the loader and unloads every texture, including ones walls still refer to; for shutdown
+void UnloadTextureCache(TextureCache& cache) {
+    cache.loader.reset();
+    for (const auto& asset : cache.assets) {
+        if (!asset->loading && !asset->sharedWith) UnloadTexture(asset->texture);
+    }
+    if (cache.placeholder.id != 0) UnloadTexture(cache.placeholder);
+    cache.placeholder = {};
+    cache.assets.clear();
+    cache.byPath.clear();
+    cache.byHash.clear();
+    cache.residentBytes = 0;
+}
+
+Vector3 WallNormal(const std::vector<Vector3>& vertices) {
+    return Vector3Normalize(Vector3CrossProduct(
+        Vector3Subtract(vertices[1], vertices[0]),
+        Vector3Subtract(vertices[2], vertices[0])
+    ));
+}
+
+WallUVFrame ComputeWallUVFrame(const std::vector<Vector3>& vertices) {
+    Vector3 minV = vertices[0], maxV = vertices[0];
+    for (const auto& v : vertices) {
+        minV = Vector3Min(minV, v);
+        maxV = Vector3Max(maxV, v);
+    }
+    WallUVFrame frame;
+    frame.min = minV;
+    frame.range = Vector3Subtract(maxV, minV);
+    bool useXY = (frame.range.x > frame.range.y && frame.range.x > frame.range.z);
+    bool useYZ = (!useXY && frame.range.y > frame.range.z);
+    frame.u = useYZ ? 1 : 0;
+    frame.v = useXY ? 1 : 2;
+    return frame;
+}
+
+Vector2 WallUV(const WallUVFrame& frame, Vector3 p) {
+    float coord[2];
+    int axes[2] = {frame.u, frame.v};
+    for (int k = 0; k < 2; k++) {
+        float range = AxisValue(frame.range, axes[k]);
+        // A wall flat along a projection axis gets a constant coordinate instead of NaN
+        coord[k] = range > 0.0f ? (AxisValue(p, axes[k]) - AxisValue(frame.min, axes[k])) / range : 0.0f;
+    }
+    return {coord[0], coord[1]};
+}
+
+void AppendObjFloat(std::string& out, float value) {
+    char buffer[32];
+    std::to_chars_result result = std::to_chars(buffer, buffer + sizeof(buffer), value);
+    out.append(buffer, result.ptr);
+}
+
+void AppendObjInt(std::string& out, int value) {
+    char buffer[16];
+    std::to_chars_result result = std::to_chars(buffer, buffer + sizeof(buffer), value);
+    out.append(buffer, result.ptr);
+}
+
+void FormatObjModule(const ObjExportModule& module, int firstVertex, ObjModuleChunk& chunk) {
+    const NodeStore& nodes = module.nodes;
+    int count = NodeCount(nodes);
+    chunk.vertices.clear();
+    chunk.lines.clear();
+    chunk.faces.clear();
+    chunk.vertices.reserve((size_t)nodes.liveCount * 40 + 32);
+    size_t rowEntries = nodes.implicitLattice ? (size_t)count * 6 : nodes.targets.size();
+    chunk.lines.reserve(rowEntries * 8 + nodes.overflow.size() * 8);
+    chunk.faces.reserve(module.wallIndices.size() * 8 + module.wallStarts.size() * 4);
+    
+    chunk.vertices += "# Module ";
+    AppendObjInt(chunk.vertices, module.id);
+    chunk.vertices += '\n';
+    chunk.vertexIndex.assign(count, -1);
+    int vertex = firstVertex;
+    for (int i = 0; i < count; i++) {
+        if (!IsNodeAlive(nodes, i)) continue;
+        Vector3 p = NodePosition(nodes, i);
+        chunk.vertices += "v ";
+        AppendObjFloat(chunk.vertices, p.x);
+        chunk.vertices += ' ';
+        AppendObjFloat(chunk.vertices, p.y);
+        chunk.vertices += ' ';
+        AppendObjFloat(chunk.vertices, p.z);
+        chunk.vertices += '\n';
+        chunk.vertexIndex[i] = vertex++;
+    }
+    
+    const std::vector<int>& index = chunk.vertexIndex;
+    ForEachEdge(nodes, [&](int a, int b) {
+        chunk.lines += "l ";
+        AppendObjInt(chunk.lines, index[a]);
+        chunk.lines += ' ';
+        AppendObjInt(chunk.lines, index[b]);
+        chunk.lines += '\n';
+    });
+    
+    for (size_t w = 0; w + 1 < module.wallStarts.size(); w++) {
+        int first = module.wallStarts[w];
+        int last = module.wallStarts[w + 1];
+        if (last - first < 3) continue;
+        chunk.faces += 'f';
+        for (int k = first; k < last; k++) {
+            chunk.faces += ' ';
+            AppendObjInt(chunk.faces, index[module.wallIndices[k]]);
+        }
+        chunk.faces += '\n';
+    }
+}
+
+// Copy what the export needs so the editor can keep changing the scene
+void SnapshotObjExport(ObjExporter& exporter, const std::vector<GridModule>& modules, const SceneGraph& graph) {
+    exporter.modules.resize(modules.size());
+    for (size_t m = 0; m < modules.size(); m++) {
+        ObjExportModule& out = exporter.modules[m];
+        out.id = modules[m].id;
+        out.nodes = modules[m].nodes;
+        out.wallStarts.assign(1, 0);
+        out.wallIndices.clear();
+        for (const auto& wall : modules[m].walls) {
+            out.wallIndices.insert(out.wallIndices.end(), wall.nodeIndices.begin(), wall.nodeIndices.end());
+            out.wallStarts.push_back((int)out.wallIndices.size());
+        }
+    }
+    exporter.crossEdges.clear();
+    ForEachCrossEdge(graph, [&](NodeRef a, NodeRef b) { exporter.crossEdges.push_back({a, b}); });
+}
+
+// Format the snapshot, then write every chunk in order with one call each
+bool WriteObjExport(ObjExporter& exporter) {
+    size_t moduleCount = exporter.modules.size();
+    exporter.chunks.resize(moduleCount);
+    
+    // Vertex numbers are global, so each module starts after the live nodes of the ones before it
+    std::vector<int> firstVertex(moduleCount);
+    int vertexCount = 1; // OBJ indices start at 1
+    for (size_t m = 0; m < moduleCount; m++) {
+        firstVertex[m] = vertexCount;
+        vertexCount += exporter.modules[m].nodes.liveCount;
+    }
+    
+    ParallelFor(moduleCount, [&](size_t m) {
+        FormatObjModule(exporter.modules[m], firstVertex[m], exporter.chunks[m]);
+    });
+    
+    // The snapshot keeps the scene's id order, as FindModuleIndex relies on
+    auto moduleIndex = [&](int moduleId) {
+        auto it = std::lower_bound(exporter.modules.begin(), exporter.modules.end(), moduleId,
+            [](const ObjExportModule& module, int id) { return module.id < id; });
+        return it != exporter.modules.end() && it->id == moduleId ? (int)(it - exporter.modules.begin()) : -1;
+    };
+    
+    std::string& cross = exporter.crossLines;
+    cross.clear();
+    for (const CrossEdge& edge : exporter.crossEdges) {
+        int ma = moduleIndex(edge.a.moduleId), mb = moduleIndex(edge.b.moduleId);
+        if (ma == -1 || mb == -1) continue;
+        cross += "l ";
+        AppendObjInt(cross, exporter.chunks[ma].vertexIndex[edge.a.node]);
+        cross += ' ';
+        AppendObjInt(cross, exporter.chunks[mb].vertexIndex[edge.b.node]);
+        cross += '\n';
+    }
+    
+    FILE* file = fopen(exporter.filename.c_str(), "wb");
+    if (!file) return false;
+    setvbuf(file, nullptr, _IONBF, 0); // Chunks are already large, skip the copy into a stdio buffer
+    bool ok = true;
+    auto write = [&](const std::string& text) {
+        if (ok && !text.empty()) ok = fwrite(text.data(), 1, text.size(), file) == text.size();
+    };
+    write("# OBJ file exported from GreyScaleCube\n# Generated model\n\n");
+    for (const auto& chunk : exporter.chunks) write(chunk.vertices);
+    write("\n# Connections (lines)\n");
+    for (const auto& chunk : exporter.chunks) write(chunk.lines);
+    write(cross);
+    write("\n# Walls (faces)\n");
+    for (const auto& chunk : exporter.chunks) write(chunk.faces);
+    if (fclose(file) != 0) ok = false;
+    return ok;
+}
+
+// Starts exporting a snapshot of the scene; false if an export is still running
+bool StartObjExport(ObjExporter& exporter, const std::vector<GridModule>& modules, const SceneGraph& graph, const char* filename) {
+    if (exporter.running) return false;
+    SnapshotObjExport(exporter, modules, graph);
+    exporter.filename = filename;
+    exporter.finished = false;
+    exporter.running = true;
+    exporter.worker = std::thread([&exporter]() {
+        exporter.succeeded = WriteObjExport(exporter);
+        exporter.finished = true;
+    });
+    return true;
+}
+
+// True once, on the first call after a running export completes
+bool PollObjExport(ObjExporter& exporter) {
+    if (!exporter.running || !exporter.finished) return false;
+    exporter.worker.join();
+    exporter.running = false;
+    return true;
+}
+
+void WaitObjExport(ObjExporter& exporter) {
+    if (!exporter.running) return;
+    exporter.worker.join();
+    exporter.running = false;
+}
+
+// Synchronous export, for callers that need the file before continuing
+bool ExportToOBJ(const std::vector<GridModule>& modules, const SceneGraph& graph, const char* filename) {
+    ObjExporter exporter;
+    SnapshotObjExport(exporter, modules, graph);
+    exporter.filename = filename;
+    return WriteObjExport(exporter);
+}
+
+// Project files: a header followed by tagged chunks, each with its own
+// version so readers can skip chunks they do not know. Payload arrays are
+// 8-byte aligned and stored in host (little-endian) order, so a loader can
+// map the file and view node positions and adjacency in place.
+//
+//   PROJ  nextModuleId, module count
+//   TEXR  texture path table; an empty path is a generated texture
+//   MODL  one per module: header, x, y, z, CSR offsets, targets, alive flags,
+//         free slots, wall starts, wall node indices, wall texture refs
+//   LATT  in place of MODL for a module still an implicit lattice: header with
+//         the lattice parameters, then the wall arrays as in MODL
+//   XEDG  connections between modules as (module, node, module, node)
+static const uint32_t PROJECT_VERSION = 1;
+
+constexpr uint32_t ProjectTag(char a, char b, char c, char d) {
+    return (uint32_t)(uint8_t)a | ((uint32_t)(uint8_t)b << 8) | ((uint32_t)(uint8_t)c << 16) | ((uint32_t)(uint8_t)d << 24);
+}
+
+static const uint32_t PROJECT_MAGIC = ProjectTag('G', 'S', 'C', 'P');
+static const uint32_t CHUNK_PROJECT = ProjectTag('P', 'R', 'O', 'J');
+static const uint32_t CHUNK_TEXTURES = ProjectTag('T', 'E', 'X', 'R');
+static const uint32_t CHUNK_MODULE = ProjectTag('M', 'O', 'D', 'L');
+static const uint32_t CHUNK_LATTICE = ProjectTag('L', 'A', 'T', 'T');
+static const uint32_t CHUNK_CROSS_EDGES = ProjectTag('X', 'E', 'D', 'G');
+
+struct ProjectFileHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t chunkCount;
+    uint32_t reserved;
+};
+
+struct ProjectChunkHeader {
+    uint32_t tag;
+    uint32_t version;
+    uint64_t size; // Payload bytes, padding included
+};
+
+struct ProjectInfo {
+    int32_t nextModuleId;
+    uint32_t moduleCount;
+};
+
+struct ProjectModuleHeader {
+    int32_t id;
+    float center[3];
+    uint32_t slotCount;
+    uint32_t offsetCount;
+    uint32_t targetCount;
+    uint32_t freeCount;
+    uint32_t wallCount;
+    uint32_t wallIndexCount;
+};
+
+struct ProjectLatticeHeader {
+    int32_t id;
+    float center[3];
+    int32_t size[3];
+    float origin[3];
+    float spacing[3];
+    uint32_t wallCount;
+    uint32_t wallIndexCount;
+};
+
+void WriteProjectBytes(std::ofstream& file, const void* data, size_t size) {
+    static const char zeros[8] = {};
+    if (size > 0) file.write((const char*)data, (std::streamsize)size);
+    if (size % 8) file.write(zeros, (std::streamsize)(8 - size % 8));
+}
+
+template <typename T>
+void WriteProjectArray(std::ofstream& file, const T* data, size_t count) {
+    WriteProjectBytes(file, data, count * sizeof(T));
+}
+
+// Writes a chunk header, then the payload from fn, then patches in the payload size
+template <typename Fn>
+void WriteProjectChunk(std::ofstream& file, uint32_t tag, Fn fn) {
+    ProjectChunkHeader header = {tag, PROJECT_VERSION, 0};
+    std::streampos start = file.tellp();
+    file.write((const char*)&header, sizeof(header));
+    fn();
+    std::streampos end = file.tellp();
+    header.size = (uint64_t)(end - start) - sizeof(header);
+    file.seekp(start);
+    file.write((const char*)&header, sizeof(header));
+    file.seekp(end);
+}
+
+// Edits not yet folded into the CSR arrays, which files store in one piece
+bool HasPendingAdjacency(const NodeStore& nodes) {
+    return !nodes.overflow.empty() || nodes.removedCount > 0 || CompactedRowCount(nodes) < NodeCount(nodes);
+}
+
+// Writes to a temporary file and renames it over the target, so modules still
+// viewing a previously loaded copy of the file keep their mapping intact
+bool SaveProject(std::vector<GridModule>& modules, const SceneGraph& graph, int nextModuleId, const char* filename) {
+    std::string tempName = std::string(filename) + ".tmp";
+    std::ofstream file(tempName, std::ios::binary);
+    if (!file.is_open()) return false;
+    
+    // Fold pending edits into the CSR arrays so the file holds adjacency in one piece
+    for (auto& module : modules) {
+        if (HasPendingAdjacency(module.nodes)) CompactAdjacency(module.nodes);
+    }
+    
+    std::vector<std::string> texturePaths;
+    std::unordered_map<std::string, int> textureIndex;
+    auto textureRef = [&](const Wall& wall) -> int32_t {
+        if (!wall.texture) return -1;
+        const std::string& path = wall.texture->path;
+        auto found = textureIndex.find(path);
+        if (found != textureIndex.end()) return found->second;
+        textureIndex[path] = (int)texturePaths.size();
+        texturePaths.push_back(path);
+        return (int)texturePaths.size() - 1;
+    };
+    std::vector<std::vector<int32_t>> wallTextures(modules.size());
+    for (size_t m = 0; m < modules.size(); m++) {
+        for (const auto& wall : modules[m].walls) wallTextures[m].push_back(textureRef(wall));
+    }
+    
+    ProjectFileHeader header = {PROJECT_MAGIC, PROJECT_VERSION, (uint32_t)modules.size() + 3, 0};
+    file.write((const char*)&header, sizeof(header));
+    
+    WriteProjectChunk(file, CHUNK_PROJECT, [&]() {
+        ProjectInfo info = {nextModuleId, (uint32_t)modules.size()};
+        WriteProjectBytes(file, &info, sizeof(info));
+    });
+    
+    WriteProjectChunk(file, CHUNK_TEXTURES, [&]() {
+        std::vector<char> table;
+        uint32_t count = (uint32_t)texturePaths.size();
+        table.insert(table.end(), (const char*)&count, (const char*)&count + sizeof(count));
+        for (const auto& path : texturePaths) {
+            uint32_t length = (uint32_t)path.size();
+            table.insert(table.end(), (const char*)&length, (const char*)&length + sizeof(length));
+            table.insert(table.end(), path.begin(), path.end());
+        }
+        WriteProjectBytes(file, table.data(), table.size());
+    });
+    
+    for (size_t m = 0; m < modules.size(); m++) {
+        const GridModule& module = modules[m];
+        const NodeStore& nodes = module.nodes;
+        std::vector<uint32_t> wallStarts(1, 0);
+        std::vector<int32_t> wallIndices;
+        for (const auto& wall : module.walls) {
+            wallIndices.insert(wallIndices.end(), wall.nodeIndices.begin(), wall.nodeIndices.end());
+            wallStarts.push_back((uint32_t)wallIndices.size());
+        }
+        
+        if (nodes.implicitLattice) {
+            WriteProjectChunk(file, CHUNK_LATTICE, [&]() {
+                const LatticeParams& lattice = nodes.lattice;
+                ProjectLatticeHeader lh = {};
+                lh.id = module.id;
+                lh.center[0] = module.center.x;
+                lh.center[1] = module.center.y;
+                lh.center[2] = module.center.z;
+                lh.size[0] = lattice.sizeX;
+                lh.size[1] = lattice.sizeY;
+                lh.size[2] = lattice.sizeZ;
+                for (int axis = 0; axis < 3; axis++) {
+                    lh.origin[axis] = AxisValue(lattice.origin, axis);
+                    lh.spacing[axis] = AxisValue(lattice.spacing, axis);
+                }
+                lh.wallCount = (uint32_t)module.walls.size();
+                lh.wallIndexCount = (uint32_t)wallIndices.size();
+                WriteProjectBytes(file, &lh, sizeof(lh));
+                
+                WriteProjectArray(file, wallStarts.data(), wallStarts.size());
+                WriteProjectArray(file, wallIndices.data(), wallIndices.size());
+                WriteProjectArray(file, wallTextures[m].data(), wallTextures[m].size());
+            });
+            continue;
+        }
+        
+        WriteProjectChunk(file, CHUNK_MODULE, [&]() {
+            ProjectModuleHeader mh = {};
+            mh.id = module.id;
+            mh.center[0] = module.center.x;
+            mh.center[1] = module.center.y;
+            mh.center[2] = module.center.z;
+            mh.slotCount = (uint32_t)NodeCount(nodes);
+            mh.offsetCount = (uint32_t)nodes.offsets.size();
+            mh.targetCount = (uint32_t)nodes.targets.size();
+            mh.freeCount = (uint32_t)nodes.freeSlots.size();
+            mh.wallCount = (uint32_t)module.walls.size();
+            mh.wallIndexCount = (uint32_t)wallIndices.size();
+            WriteProjectBytes(file, &mh, sizeof(mh));
+            
+            WriteProjectArray(file, nodes.x.data(), nodes.x.size());
+            WriteProjectArray(file, nodes.y.data(), nodes.y.size());
+            WriteProjectArray(file, nodes.z.data(), nodes.z.size());
+            WriteProjectArray(file, nodes.offsets.data(), nodes.offsets.size());
+            WriteProjectArray(file, nodes.targets.data(), nodes.targets.size());
+            WriteProjectArray(file, nodes.alive.data(), nodes.alive.size());
+            WriteProjectArray(file, nodes.freeSlots.data(), nodes.freeSlots.size());
+            WriteProjectArray(file, wallStarts.data(), wallStarts.size());
+            WriteProjectArray(file, wallIndices.data(), wallIndices.size());
+            WriteProjectArray(file, wallTextures[m].data(), wallTextures[m].size());
+        });
+    }
+    
+    WriteProjectChunk(file, CHUNK_CROSS_EDGES, [&]() {
+        std::vector<int32_t> edges;
+        ForEachCrossEdge(graph, [&](NodeRef a, NodeRef b) {
+            edges.insert(edges.end(), {a.moduleId, a.node, b.moduleId, b.node});
+        });
+        uint32_t count[2] = {(uint32_t)(edges.size() / 4), 0};
+        WriteProjectBytes(file, count, sizeof(count));
+        WriteProjectArray(file, edges.data(), edges.size());
+    });
+    
+    file.close();
+    if (file.fail()) {
+        std::remove(tempName.c_str());
+        return false;
+    }
+#ifdef _WIN32
+    std::remove(filename); // rename does not replace an existing file here
+#endif
+    return std::rename(tempName.c_str(), filename) == 0;
+}
+
+// Maps a whole file read-only. The returned pointer unmaps it when the last owner lets go.
+std::shared_ptr<const unsigned char> MapReadOnlyFile(const char* filename, size_t& size) {
+    size = 0;
+#ifndef _WIN32
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0) return nullptr;
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size <= 0) {
+        close(fd);
+        return nullptr;
+    }
+    size_t length = (size_t)info.st_size;
+    void* data = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) return nullptr;
+    size = length;
+    return std::shared_ptr<const unsigned char>((const unsigned char*)data,
+        [length](const unsigned char* p) { munmap((void*)p, length); });
+#else
+    // No mmap here: read the file into one buffer and view that instead
+    std::ifstream file(filename, std::ios::binary | std::ios::ate);
+    if (!file.is_open()) return nullptr;
+    std::streamsize length = file.tellg();
+    if (length <= 0) return nullptr;
+    unsigned char* data = new unsigned char[(size_t)length];
+    file.seekg(0);
+    if (!file.read((char*)data, length)) {
+        delete[] data;
+        return nullptr;
+    }
+    size = (size_t)length;
+    return std::shared_ptr<const unsigned char>(data, [](const unsigned char* p) { delete[] p; });
+#endif
+}
+
+// Bounds-checked cursor over one chunk payload
+struct ProjectReader {
+    const unsigned char* data;
+    size_t size;
+    size_t pos = 0;
+    bool ok = true;
+};
+
+// Returns count elements in place and advances past their padding, or nullptr if the chunk is too short
+template <typename T>
+const T* ReadProjectArray(ProjectReader& reader, size_t count) {
+    size_t bytes = count * sizeof(T);
+    if (!reader.ok || count > reader.size / sizeof(T) || bytes > reader.size - reader.pos) {
+        reader.ok = false;
+        return nullptr;
+    }
+    const T* result = (const T*)(reader.data + reader.pos);
+    reader.pos += (bytes + 7) & ~(size_t)7;
+    if (reader.pos > reader.size) reader.pos = reader.size;
+    return result;
+}
+
+// Texture for a path from the table, loaded in the background; generated or
+// missing ones become the default blue
+std::shared_ptr<TextureAsset> LoadProjectTexture(TextureCache& textures, const std::string& path) {
+    if (auto asset = RequestTexture(textures, path)) return asset;
+    return AcquireSolidTexture(textures, BLUE, 256, 256);
+}
+
+// Reads the wall arrays that end MODL and LATT payloads, checking every node index against 'slots'
+bool LoadProjectWalls(ProjectReader& reader, uint32_t wallCount, uint32_t wallIndexCount, size_t slots,
+                      GridModule& module, std::vector<int32_t>& wallTextureRefs) {
+    const uint32_t* wallStarts = ReadProjectArray<uint32_t>(reader, (size_t)wallCount + 1);
+    const int32_t* wallIndices = ReadProjectArray<int32_t>(reader, wallIndexCount);
+    const int32_t* wallTextures = ReadProjectArray<int32_t>(reader, wallCount);
+    if (!reader.ok) return false;
+    
+    if (wallStarts[0] != 0 || wallStarts[wallCount] != wallIndexCount) return false;
+    for (uint32_t w = 0; w < wallCount; w++) {
+        if (wallStarts[w + 1] < wallStarts[w]) return false;
+        if (wallTextures[w] < -1) return false;
+    }
+    for (uint32_t k = 0; k < wallIndexCount; k++) {
+        if (wallIndices[k] < 0 || (size_t)wallIndices[k] >= slots) return false;
+    }
+    
+    wallTextureRefs.assign(wallTextures, wallTextures + wallCount);
+    module.walls.clear();
+    module.walls.reserve(wallCount);
+    for (uint32_t w = 0; w < wallCount; w++) {
+        Wall wall;
+        wall.nodeIndices.assign(wallIndices + wallStarts[w], wallIndices + wallStarts[w + 1]);
+        wall.id = NewWallId();
+        module.walls.push_back(wall);
+    }
+    return true;
+}
+
+// Reads one MODL payload. Positions and adjacency view the mapping directly;
+// everything else is small and copied.
+bool LoadProjectModule(ProjectReader& reader, const std::shared_ptr<const unsigned char>& mapping,
+                       GridModule& module, std::vector<int32_t>& wallTextureRefs) {
+    const ProjectModuleHeader* mh = ReadProjectArray<ProjectModuleHeader>(reader, 1);
+    if (!mh) return false;
+    size_t slots = mh->slotCount;
+    const float* x = ReadProjectArray<float>(reader, slots);
+    const float* y = ReadProjectArray<float>(reader, slots);
+    const float* z = ReadProjectArray<float>(reader, slots);
+    const int32_t* offsets = ReadProjectArray<int32_t>(reader, mh->offsetCount);
+    const int32_t* targets = ReadProjectArray<int32_t>(reader, mh->targetCount);
+    const uint8_t* alive = ReadProjectArray<uint8_t>(reader, slots);
+    const int32_t* freeSlots = ReadProjectArray<int32_t>(reader, mh->freeCount);
+    if (!reader.ok) return false;
+    
+    // Validate everything that is later used as an index
+    if (slots > (size_t)INT32_MAX || mh->offsetCount > slots + 1) return false;
+    if (mh->offsetCount > 0) {
+        if (offsets[0] != 0 || (uint32_t)offsets[mh->offsetCount - 1] != mh->targetCount) return false;
+        for (uint32_t i = 1; i < mh->offsetCount; i++) {
+            if (offsets[i] < offsets[i - 1]) return false;
+        }
+    } else if (mh->targetCount != 0) {
+        return false;
+    }
+    for (uint32_t k = 0; k < mh->targetCount; k++) {
+        if (targets[k] < -1 || targets[k] >= (int32_t)slots) return false;
+    }
+    for (uint32_t i = 0; i < mh->freeCount; i++) {
+        if (freeSlots[i] < 0 || freeSlots[i] >= (int32_t)slots || alive[freeSlots[i]]) return false;
+    }
+    if (!LoadProjectWalls(reader, mh->wallCount, mh->wallIndexCount, slots, module, wallTextureRefs)) return false;
+    
+    module.id = mh->id;
+    module.center = {mh->center[0], mh->center[1], mh->center[2]};
+    
+    NodeStore& nodes = module.nodes;
+    nodes.x.setView(x, slots, mapping);
+    nodes.y.setView(y, slots, mapping);
+    nodes.z.setView(z, slots, mapping);
+    nodes.offsets.setView(offsets, mh->offsetCount, mapping);
+    nodes.targets.setView(targets, mh->targetCount, mapping);
+    nodes.overflow.clear();
+    nodes.removedCount = 0;
+    for (uint32_t k = 0; k < mh->targetCount; k++) {
+        if (targets[k] < 0) nodes.removedCount++;
+    }
+    nodes.alive.setView(alive, slots, mapping);
+    nodes.generation.assign(slots, 0);
+    nodes.freeSlots.assign(freeSlots, freeSlots + mh->freeCount);
+    nodes.liveCount = 0;
+    for (size_t i = 0; i < slots; i++) {
+        if (alive[i]) nodes.liveCount++;
+    }
+    return true;
+}
+
+// Reads one LATT payload into a module whose nodes stay implicit
+bool LoadProjectLattice(ProjectReader& reader, GridModule& module, std::vector<int32_t>& wallTextureRefs) {
+    const ProjectLatticeHeader* lh = ReadProjectArray<ProjectLatticeHeader>(reader, 1);
+    if (!lh) return false;
+    int64_t slots = 1;
+    for (int axis = 0; axis < 3; axis++) {
+        if (lh->size[axis] < 1) return false;
+        slots *= lh->size[axis];
+        if (slots > INT32_MAX) return false;
+    }
+    if (!LoadProjectWalls(reader, lh->wallCount, lh->wallIndexCount, (size_t)slots, module, wallTextureRefs)) return false;
+    
+    module.id = lh->id;
+    module.center = {lh->center[0], lh->center[1], lh->center[2]};
+    
+    NodeStore& nodes = module.nodes;
+    nodes = NodeStore();
+    nodes.lattice.sizeX = lh->size[0];
+    nodes.lattice.sizeY = lh->size[1];
+    nodes.lattice.sizeZ = lh->size[2];
+    nodes.lattice.origin = {lh->origin[0], lh->origin[1], lh->origin[2]};
+    nodes.lattice.spacing = {lh->spacing[0], lh->spacing[1], lh->spacing[2]};
+    nodes.implicitLattice = true;
+    nodes.liveCount = (int)slots;
+    return true;
+}
+
+// Loads into the given containers, which are only written once the whole file
+// has been read. Textures are loaded last, so a rejected file loads none.
+bool LoadProject(const char* filename, std::vector<GridModule>& modules, SceneGraph& graph, int& nextModuleId, TextureCache& textures) {
+    size_t size = 0;
+    std::shared_ptr<const unsigned char> mapping = MapReadOnlyFile(filename, size);
+    if (!mapping) return false;
+    
+    ProjectReader file = {mapping.get(), size};
+    const ProjectFileHeader* header = ReadProjectArray<ProjectFileHeader>(file, 1);
+    if (!header || header->magic != PROJECT_MAGIC) {
+        printf("%s is not a project file\n", filename);
+        return false;
+    }
+    if (header->version > PROJECT_VERSION) {
+        printf("%s was written by a newer version (%u)\n", filename, header->version);
+        return false;
+    }
+    
+    std::vector<GridModule> loadedModules;
+    std::vector<std::vector<int32_t>> wallTextureRefs;
+    std::vector<std::string> texturePaths;
+    std::vector<int32_t> crossEdges;
+    const ProjectInfo* info = nullptr;
+    for (uint32_t c = 0; c < header->chunkCount; c++) {
+        const ProjectChunkHeader* chunk = ReadProjectArray<ProjectChunkHeader>(file, 1);
+        // Chunks are padded to 8 bytes; an odd size would misalign everything viewed after it
+        if (!chunk || chunk->size > file.size - file.pos || chunk->size % 8 != 0) {
+            printf("%s is truncated\n", filename);
+            return false;
+        }
+        ProjectReader payload = {file.data + file.pos, (size_t)chunk->size};
+        file.pos += (size_t)chunk->size;
+        if (chunk->version > PROJECT_VERSION) continue; // Newer layout of a known chunk: skip it
+        
+        if (chunk->tag == CHUNK_PROJECT) {
+            info = ReadProjectArray<ProjectInfo>(payload, 1);
+        } else if (chunk->tag == CHUNK_TEXTURES) {
+            const uint32_t* count = ReadProjectArray<uint32_t>(payload, 1);
+            payload.pos = sizeof(uint32_t); // Entries are packed, not padded
+            for (uint32_t i = 0; count && i < *count; i++) {
+                uint32_t length = 0;
+                if (payload.size - payload.pos < sizeof(length)) {
+                    payload.ok = false;
+                    break;
+                }
+                memcpy(&length, payload.data + payload.pos, sizeof(length));
+                payload.pos += sizeof(length);
+                if (length > payload.size - payload.pos) {
+                    payload.ok = false;
+                    break;
+                }
+                texturePaths.emplace_back((const char*)payload.data + payload.pos, length);
+                payload.pos += length;
+            }
+        } else if (chunk->tag == CHUNK_MODULE) {
+            loadedModules.emplace_back();
+            wallTextureRefs.emplace_back();
+            if (!LoadProjectModule(payload, mapping, loadedModules.back(), wallTextureRefs.back())) payload.ok = false;
+        } else if (chunk->tag == CHUNK_LATTICE) {
+            loadedModules.emplace_back();
+            wallTextureRefs.emplace_back();
+            if (!LoadProjectLattice(payload, loadedModules.back(), wallTextureRefs.back())) payload.ok = false;
+        } else if (chunk->tag == CHUNK_CROSS_EDGES) {
+            const uint32_t* count = ReadProjectArray<uint32_t>(payload, 2);
+            const int32_t* edges = count ? ReadProjectArray<int32_t>(payload, (size_t)count[0] * 4) : nullptr;
+            if (edges) crossEdges.assign(edges, edges + (size_t)count[0] * 4);
+        }
+        // FindModuleIndex needs ids strictly increasing in file order
+        if ((chunk->tag == CHUNK_MODULE || chunk->tag == CHUNK_LATTICE) && payload.ok && loadedModules.size() > 1 &&
+            loadedModules.back().id <= loadedModules[loadedModules.size() - 2].id) {
+            payload.ok = false;
+        }
+        if (!payload.ok) {
+            printf("%s has a damaged chunk\n", filename);
+            return false;
+        }
+    }
+    if (!info || info->moduleCount != loadedModules.size()) {
+        printf("%s is missing modules\n", filename);
+        return false;
+    }
+    
+    SceneGraph loadedGraph;
+    for (size_t k = 0; k < crossEdges.size(); k += 4) {
+        NodeRef a = {crossEdges[k], crossEdges[k + 1]};
+        NodeRef b = {crossEdges[k + 2], crossEdges[k + 3]};
+        int ma = FindModuleIndex(loadedModules, a.moduleId);
+        int mb = FindModuleIndex(loadedModules, b.moduleId);
+        if (ma == -1 || mb == -1 || !IsNodeAlive(loadedModules[ma].nodes, a.node) ||
+            !IsNodeAlive(loadedModules[mb].nodes, b.node)) {
+            printf("%s has a connection to a missing node\n", filename);
+            return false;
+        }
+        AddCrossEdge(loadedGraph, a, b);
+    }
+    
+    for (const auto& refs : wallTextureRefs) {
+        for (int32_t ref : refs) {
+            if (ref >= (int32_t)texturePaths.size()) {
+                printf("%s refers to a missing texture\n", filename);
+                return false;
+            }
+        }
+    }
+    
+    // Each table entry is loaded once and shared by the walls using it
+    std::vector<std::shared_ptr<TextureAsset>> tableTextures(texturePaths.size());
+    for (size_t m = 0; m < loadedModules.size(); m++) {
+        std::vector<Wall>& walls = loadedModules[m].walls;
+        for (size_t w = 0; w < walls.size(); w++) {
+            int32_t ref = wallTextureRefs[m][w];
+            if (ref < 0) continue;
+            if (!tableTextures[ref]) tableTextures[ref] = LoadProjectTexture(textures, texturePaths[ref]);
+            walls[w].texture = tableTextures[ref];
+        }
+    }
+    
+    int loadedNextId = info->nextModuleId;
+    for (const auto& module : loadedModules) loadedNextId = std::max(loadedNextId, module.id + 1);
+    
+    modules = std::move(loadedModules);
+    graph = std::move(loadedGraph);
+    nextModuleId = loadedNextId;
+    return true;
+}
+
+// Page files hold one module's node arrays while it is paged out, in the
+// project file's 8-byte aligned layout: header, x, y, z, CSR offsets,
+// targets, alive flags, generations, free slots. They only live as long as
+// the editor session that wrote them.
+static const uint32_t PAGE_MAGIC = ProjectTag('G', 'S', 'P', 'G');
+static const uint32_t PAGE_VERSION = 1;
+
+struct NodePageHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t slotCount;
+    uint32_t offsetCount;
+    uint32_t targetCount;
+    uint32_t freeCount;
+    int32_t liveCount;
+    int32_t removedCount;
+};
+
+bool WriteNodePage(const NodeStore& nodes, const std::string& filename) {
+    std::string tempName = filename + ".tmp";
+    std::ofstream file(tempName, std::ios::binary);
+    if (!file.is_open()) return false;
+    
+    NodePageHeader header = {PAGE_MAGIC, PAGE_VERSION, (uint32_t)NodeCount(nodes), (uint32_t)nodes.offsets.size(),
+                             (uint32_t)nodes.targets.size(), (uint32_t)nodes.freeSlots.size(), nodes.liveCount, nodes.removedCount};
+    WriteProjectBytes(file, &header, sizeof(header));
+    WriteProjectArray(file, nodes.x.data(), nodes.x.size());
+    WriteProjectArray(file, nodes.y.data(), nodes.y.size());
+    WriteProjectArray(file, nodes.z.data(), nodes.z.size());
+    WriteProjectArray(file, nodes.offsets.data(), nodes.offsets.size());
+    WriteProjectArray(file, nodes.targets.data(), nodes.targets.size());
+    WriteProjectArray(file, nodes.alive.data(), nodes.alive.size());
+    WriteProjectArray(file, nodes.generation.data(), nodes.generation.size());
+    WriteProjectArray(file, nodes.freeSlots.data(), nodes.freeSlots.size());
+    
+    file.close();
+    if (file.fail()) {
+        std::remove(tempName.c_str());
+        return false;
+    }
+#ifdef _WIN32
+    std::remove(filename.c_str());
+#endif
+    return std::rename(tempName.c_str(), filename.c_str()) == 0;
+}
+
+// Point the node arrays at a page file instead of owned memory
+bool ViewNodePage(NodeStore& nodes, const std::string& filename) {
+    size_t size = 0;
+    std::shared_ptr<const unsigned char> mapping = MapReadOnlyFile(filename.c_str(), size);
+    if (!mapping) return false;
+    
+    ProjectReader reader = {mapping.get(), size};
+    const NodePageHeader* header = ReadProjectArray<NodePageHeader>(reader, 1);
+    if (!header || header->magic != PAGE_MAGIC || header->version != PAGE_VERSION) return false;
+    size_t slots = header->slotCount;
+    const float* x = ReadProjectArray<float>(reader, slots);
+    const float* y = ReadProjectArray<float>(reader, slots);
+    const float* z = ReadProjectArray<float>(reader, slots);
+    const int32_t* offsets = ReadProjectArray<int32_t>(reader, header->offsetCount);
+    const int32_t* targets = ReadProjectArray<int32_t>(reader, header->targetCount);
+    const uint8_t* alive = ReadProjectArray<uint8_t>(reader, slots);
+    const uint32_t* generation = ReadProjectArray<uint32_t>(reader, slots);
+    const int32_t* freeSlots = ReadProjectArray<int32_t>(reader, header->freeCount);
+    if (!reader.ok) return false;
+    
+    nodes.x.setView(x, slots, mapping);
+    nodes.y.setView(y, slots, mapping);
+    nodes.z.setView(z, slots, mapping);
+    nodes.offsets.setView(offsets, header->offsetCount, mapping);
+    nodes.targets.setView(targets, header->targetCount, mapping);
+    nodes.alive.setView(alive, slots, mapping);
+    nodes.generation.setView(generation, slots, mapping);
+    // Give back spare capacity too, the budget counts it
+    nodes.freeSlots.assign(freeSlots, freeSlots + header->freeCount);
+    nodes.freeSlots.shrink_to_fit();
+    nodes.overflow.clear();
+    nodes.overflow.shrink_to_fit();
+    nodes.liveCount = header->liveCount;
+    nodes.removedCount = header->removedCount;
+    return true;
+}
+
+// Node data held in memory rather than viewed from a file; an unedited
+// project or page module holds none, and its generations only after loading
+bool NodeStoreOwnsData(const NodeStore& nodes) {
+    auto owns = [](const auto& array) { return !array.viewed() && !array.empty(); };
+    return owns(nodes.x) || owns(nodes.y) || owns(nodes.z) || owns(nodes.offsets) || owns(nodes.targets) ||
+           owns(nodes.alive) || owns(nodes.generation) || !nodes.overflow.empty();
+}
+
+template <typename T>
+size_t VectorBytes(const std::vector<T>& v) {
+    return v.capacity() * sizeof(T);
+}
+
+size_t BVHBytes(const BVH& bvh) {
+    return VectorBytes(bvh.nodes) + VectorBytes(bvh.prims) + VectorBytes(bvh.parent) + VectorBytes(bvh.primLeaf);
+}
+
+// Memory the pager can give back by paging the module out: owned node arrays,
+// picking trees and the spatial hash. Walls stay resident and are not counted.
+size_t ModuleResidentBytes(const GridModule& module) {
+    const NodeStore& nodes = module.nodes;
+    size_t bytes = nodes.x.ownedBytes() + nodes.y.ownedBytes() + nodes.z.ownedBytes() +
+                   nodes.offsets.ownedBytes() + nodes.targets.ownedBytes() + nodes.alive.ownedBytes() +
+                   nodes.generation.ownedBytes() + VectorBytes(nodes.overflow) + VectorBytes(nodes.freeSlots);
+    
+    const ModulePickBVH& pick = module.pick;
+    bytes += BVHBytes(pick.nodeTree) + BVHBytes(pick.wallTree) + VectorBytes(pick.triangles);
+    const TrianglePack& packed = pick.packed;
+    bytes += VectorBytes(packed.v0x) + VectorBytes(packed.v0y) + VectorBytes(packed.v0z) +
+             VectorBytes(packed.e1x) + VectorBytes(packed.e1y) + VectorBytes(packed.e1z) +
+             VectorBytes(packed.e2x) + VectorBytes(packed.e2y) + VectorBytes(packed.e2z);
+    
+    // Every hashed node has one cell entry; cells cost roughly a map node and an empty vector
+    const SpatialHash& hash = module.spatial;
+    bytes += VectorBytes(hash.nodeCell) + hash.nodeCell.size() * sizeof(int) +
+             hash.cells.size() * (sizeof(uint64_t) + sizeof(std::vector<int>) + 2 * sizeof(void*));
+    return bytes;
+}
+
+// Write back node data that changed since it was read from a file, then keep
+// only views of the page. A paged module that owns arrays again is written back
+// once more. Returns false, leaving the module as it was, if the page could not
+// be written.
+bool PageOutModule(ScenePager& pager, GridModule& module) {
+    if (module.paged && !NodeStoreOwnsData(module.nodes)) return true;
+    NodeStore& nodes = module.nodes;
+    if (!nodes.implicitLattice && NodeStoreOwnsData(nodes)) {
+        if (HasPendingAdjacency(nodes)) CompactAdjacency(nodes);
+        std::string filename = pager.pathPrefix + std::to_string(module.id);
+        if (!WriteNodePage(nodes, filename) || !ViewNodePage(nodes, filename)) {
+            printf("Could not page out module %d to %s\n", module.id, filename.c_str());
+            return false;
+        }
+        pager.pageWrites[module.id]++;
+    }
+    
+    module.pick = ModulePickBVH();
+    module.pick.boundsChanged = true;
+    module.spatial = SpatialHash();
+    module.paged = true;
+    return true;
+}
+
+// The page stays mapped; picking and the spatial hash rebuild from it on the next UpdateScenePicking
+void PageInModule(GridModule& module) {
+    if (!module.paged) return;
+    module.paged = false;
+    module.spatial.needsRebuild = true;
+    InvalidateModulePicking(module);
+}
+
+uint64_t PageChunkKey(const ScenePager& pager, Vector3 p) {
+    return SpatialCellKey((int)floorf(p.x / pager.chunkSize), (int)floorf(p.y / pager.chunkSize),
+                          (int)floorf(p.z / pager.chunkSize));
+}
+
+// Distance from p to the chunk holding 'center', zero inside it
+float PageChunkDistance(const ScenePager& pager, Vector3 center, Vector3 p) {
+    Vector3 min = {floorf(center.x / pager.chunkSize) * pager.chunkSize, floorf(center.y / pager.chunkSize) * pager.chunkSize,
+                   floorf(center.z / pager.chunkSize) * pager.chunkSize};
+    Vector3 max = Vector3AddValue(min, pager.chunkSize);
+    return Vector3Distance(p, Vector3Max(min, Vector3Min(p, max)));
+}
+
+// Call once per frame after edits. Chunks near 'focus' or holding a module the
+// journal refers to are wanted: their modules are paged in and they become the
+// most recently used. Then, while over budget, whole chunks that are not
+// wanted are paged out, least recently used first.
+void UpdateScenePaging(ScenePager& pager, std::vector<GridModule>& modules, const EditJournal& journal, Vector3 focus) {
+    uint64_t tick = ++pager.tick;
+    
+    // Undo and redo must find the modules they change resident
+    std::vector<int> pinned;
+    auto pinCommand = [&](const EditCommand& cmd) {
+        pinned.push_back(cmd.moduleId);
+        if (cmd.otherModuleId >= 0) pinned.push_back(cmd.otherModuleId);
+        for (const CrossEdge& edge : cmd.crossEdges) {
+            pinned.push_back(edge.a.moduleId);
+            pinned.push_back(edge.b.moduleId);
+        }
+    };
+    for (const EditCommand& cmd : journal.undoStack) pinCommand(cmd);
+    for (const EditCommand& cmd : journal.redoStack) pinCommand(cmd);
+    std::sort(pinned.begin(), pinned.end());
+    
+    pager.moduleChunks.resize(modules.size());
+    for (size_t m = 0; m < modules.size(); m++) {
+        const GridModule& module = modules[m];
+        pager.moduleChunks[m] = PageChunkKey(pager, module.center);
+        if (PageChunkDistance(pager, module.center, focus) <= pager.streamRadius ||
+            std::binary_search(pinned.begin(), pinned.end(), module.id)) {
+            pager.chunkUsed[pager.moduleChunks[m]] = tick;
+        }
+    }
+    
+    struct Candidate { uint64_t lastUsed, chunk; int module; };
+    std::vector<Candidate> candidates;
+    size_t residentBytes = 0;
+    for (size_t m = 0; m < modules.size(); m++) {
+        GridModule& module = modules[m];
+        auto used = pager.chunkUsed.find(pager.moduleChunks[m]);
+        uint64_t lastUsed = used != pager.chunkUsed.end() ? used->second : 0;
+        if (lastUsed == tick) PageInModule(module);
+        // A paged module only holds memory if something copied its arrays out of the page since
+        size_t bytes = ModuleResidentBytes(module);
+        residentBytes += bytes;
+        if (lastUsed != tick && (!module.paged || bytes > 0)) candidates.push_back({lastUsed, pager.moduleChunks[m], (int)m});
+    }
+    
+    if (residentBytes > pager.budgetBytes) {
+        std::sort(candidates.begin(), candidates.end(), [](const Candidate& a, const Candidate& b) {
+            if (a.lastUsed != b.lastUsed) return a.lastUsed < b.lastUsed;
+            return a.chunk != b.chunk ? a.chunk < b.chunk : a.module < b.module;
+        });
+        // A chunk that has started paging out is finished even once under budget
+        for (size_t i = 0; i < candidates.size(); i++) {
+            bool sameChunk = i > 0 && candidates[i].chunk == candidates[i - 1].chunk;
+            if (!sameChunk && residentBytes <= pager.budgetBytes) break;
+            GridModule& module = modules[candidates[i].module];
+            size_t before = ModuleResidentBytes(module);
+            if (!PageOutModule(pager, module)) continue;
+            size_t after = ModuleResidentBytes(module);
+            residentBytes -= std::min(residentBytes, before - std::min(before, after));
+        }
+    }
+    pager.residentBytes = residentBytes;
+    pager.pagedModules = 0;
+    for (const GridModule& module : modules) pager.pagedModules += module.paged ? 1 : 0;
+}
+
+// Delete the page files written this session. Modules still viewing one keep
+// their mapping (or, without mmap, their copy), so this is safe at any time.
+void RemoveScenePages(ScenePager& pager) {
+    for (const auto& written : pager.pageWrites) {
+        std::remove((pager.pathPrefix + std::to_string(written.first)).c_str());
+    }
+    pager.pageWrites.clear();
+}
+
+// OBJ import. The file is mapped and split on line boundaries into one range
+// per thread. A first pass counts the vertices in each range so that a second
+// pass can resolve every index, relative ones included, while parsing. Each
+// "# Module N" comment or "o" record starts a new module; lines between nodes
+// of different modules become scene graph connections.
+struct ObjParseRange {
+    const char* begin = nullptr;
+    const char* end = nullptr;
+    int firstVertex = 0;          // Vertices in the ranges before this one
+    int vertexCount = 0;
+    std::vector<float> x, y, z;
+    std::vector<int> moduleStarts; // Global vertex index at each module separator
+    std::vector<int> lines;        // Global vertex pairs
+    std::vector<int> faceStarts;   // Face f uses faceIndices[faceStarts[f], faceStarts[f + 1])
+    std::vector<int> faceIndices;
+    int skipped = 0;               // Malformed records
+};
+
+const char* SkipObjSpaces(const char* p, const char* end) {
+    while (p < end && (*p == ' ' || *p == '\t')) p++;
+    return p;
+}
+
+bool ParseObjFloat(const char*& p, const char* end, float& value) {
+    p = SkipObjSpaces(p, end);
+    if (p < end && *p == '+') p++;
+    std::from_chars_result result = std::from_chars(p, end, value);
+    if (result.ec != std::errc()) return false;
+    p = result.ptr;
+    return true;
+}
+
+// Reads one vertex reference ("7", "-2", "7/1/3") as a global zero-based index
+bool ParseObjIndex(const char*& p, const char* end, int verticesSoFar, int totalVertices, int& index) {
+    int value = 0;
+    std::from_chars_result result = std::from_chars(p, end, value);
+    if (result.ec != std::errc() || value == 0) return false;
+    p = result.ptr;
+    while (p < end && *p != ' ' && *p != '\t') p++; // Texture and normal references are not used
+    index = value > 0 ? value - 1 : verticesSoFar + value;
+    return index >= 0 && index < totalVertices;
+}
+
+bool IsObjRecord(const char* p, const char* end, const char* keyword) {
+    size_t length = strlen(keyword);
+    return (size_t)(end - p) > length && memcmp(p, keyword, length) == 0 && (p[length] == ' ' || p[length] == '\t');
+}
+
+template <typename Fn>
+void ForEachObjLine(const char* begin, const char* end, Fn fn) {
+    const char* p = begin;
+    while (p < end) {
+        const char* newline = (const char*)memchr(p, '\n', end - p);
+        const char* lineEnd = newline ? newline : end;
+        const char* trimmed = lineEnd;
+        if (trimmed > p && trimmed[-1] == '\r') trimmed--;
+        fn(SkipObjSpaces(p, trimmed), trimmed);
+        p = lineEnd + 1;
+    }
+}
+
+void CountObjVertices(ObjParseRange& range) {
+    range.vertexCount = 0;
+    ForEachObjLine(range.begin, range.end, [&](const char* p, const char* end) {
+        if (IsObjRecord(p, end, "v")) range.vertexCount++;
+    });
+}
+
+void ParseObjRange(ObjParseRange& range, int totalVertices) {
+    int vertex = range.firstVertex;
+    std::vector<int> indices;
+    ForEachObjLine(range.begin, range.end, [&](const char* p, const char* end) {
+        if (p == end) return;
+        if (IsObjRecord(p, end, "v")) {
+            float v[3] = {0.0f, 0.0f, 0.0f};
+            p += 1;
+            bool ok = ParseObjFloat(p, end, v[0]) && ParseObjFloat(p, end, v[1]) && ParseObjFloat(p, end, v[2]);
+            if (!ok) range.skipped++; // Still a vertex, so later indices stay aligned
+            range.x.push_back(v[0]);
+            range.y.push_back(v[1]);
+            range.z.push_back(v[2]);
+            vertex++;
+        } else if (IsObjRecord(p, end, "l") || IsObjRecord(p, end, "f")) {
+            bool face = *p == 'f';
+            indices.clear();
+            p += 1;
+            bool ok = true;
+            while (ok && (p = SkipObjSpaces(p, end)) < end) {
+                int index = 0;
+                ok = ParseObjIndex(p, end, vertex, totalVertices, index);
+                indices.push_back(index);
+            }
+            if (!ok || indices.size() < (face ? 3u : 2u)) {
+                range.skipped++;
+                return;
+            }
+            if (face) {
+                range.faceStarts.push_back((int)range.faceIndices.size());
+                range.faceIndices.insert(range.faceIndices.end(), indices.begin(), indices.end());
+            } else {
+                for (size_t k = 0; k + 1 < indices.size(); k++) {
+                    range.lines.push_back(indices[k]);
+                    range.lines.push_back(indices[k + 1]);
+                }
+            }
+        } else if (IsObjRecord(p, end, "o") || (IsObjRecord(p, end, "#") && IsObjRecord(SkipObjSpaces(p + 1, end), end, "Module"))) {
+            range.moduleStarts.push_back(vertex);
+        }
+    });
+}
+
+// Replaces the given scene with the contents of an OBJ file. Module ids are
+// assigned afresh; textures are not part of OBJ geometry.
+bool ImportOBJ(const char* filename, std::vector<GridModule>& modules, SceneGraph& graph, int& nextModuleId) {
+    size_t size = 0;
+    std::shared_ptr<const unsigned char> mapping = MapReadOnlyFile(filename, size);
+    if (!mapping) return false;
+    const char* data = (const char*)mapping.get();
+    const char* dataEnd = data + size;
+    
+    // Split into ranges of roughly equal size that start at the beginning of a line
+    size_t rangeCount = std::max(1u, std::thread::hardware_concurrency());
+    rangeCount = std::min(rangeCount, size / (64 * 1024) + 1);
+    std::vector<ObjParseRange> ranges;
+    const char* rangeBegin = data;
+    for (size_t r = 1; r <= rangeCount && rangeBegin < dataEnd; r++) {
+        const char* rangeEnd = r == rangeCount ? dataEnd : data + size * r / rangeCount;
+        if (rangeEnd < rangeBegin) rangeEnd = rangeBegin;
+        const char* newline = (const char*)memchr(rangeEnd, '\n', dataEnd - rangeEnd);
+        rangeEnd = newline ? newline + 1 : dataEnd;
+        ranges.emplace_back();
+        ranges.back().begin = rangeBegin;
+        ranges.back().end = rangeEnd;
+        rangeBegin = rangeEnd;
+    }
+    
+    ParallelFor(ranges.size(), [&](size_t r) { CountObjVertices(ranges[r]); });
+    long long totalVertices = 0;
+    for (auto& range : ranges) {
+        range.firstVertex = (int)totalVertices;
+        totalVertices += range.vertexCount;
+    }
+    if (totalVertices > INT32_MAX) {
+        printf("%s has too many vertices\n", filename);
+        return false;
+    }
+    ParallelFor(ranges.size(), [&](size_t r) { ParseObjRange(ranges[r], (int)totalVertices); });
+    
+    // Module boundaries as global vertex indices; vertices before the first separator form a module of their own
+    std::vector<int> moduleStarts;
+    int skipped = 0;
+    for (const auto& range : ranges) {
+        moduleStarts.insert(moduleStarts.end(), range.moduleStarts.begin(), range.moduleStarts.end());
+        skipped += range.skipped;
+    }
+    if (moduleStarts.empty() || moduleStarts[0] > 0) moduleStarts.insert(moduleStarts.begin(), 0);
+    moduleStarts.push_back((int)totalVertices);
+    size_t moduleCount = moduleStarts.size() - 1;
+    auto moduleOf = [&](int vertex) {
+        return (int)(std::upper_bound(moduleStarts.begin(), moduleStarts.end() - 1, vertex) - moduleStarts.begin()) - 1;
+    };
+    
+    std::vector<GridModule> loadedModules(moduleCount);
+    ParallelFor(moduleCount, [&](size_t m) {
+        GridModule& module = loadedModules[m];
+        int first = moduleStarts[m];
+        int count = moduleStarts[m + 1] - first;
+        std::vector<float> x(count), y(count), z(count);
+        Vector3 sum = {0.0f, 0.0f, 0.0f};
+        for (const auto& range : ranges) {
+            int lo = std::max(first, range.firstVertex);
+            int hi = std::min(first + count, range.firstVertex + range.vertexCount);
+            for (int v = lo; v < hi; v++) {
+                int k = v - range.firstVertex;
+                x[v - first] = range.x[k];
+                y[v - first] = range.y[k];
+                z[v - first] = range.z[k];
+                sum = Vector3Add(sum, {range.x[k], range.y[k], range.z[k]});
+            }
+        }
+        module.nodes.x.swap(x);
+        module.nodes.y.swap(y);
+        module.nodes.z.swap(z);
+        module.nodes.generation.assign(count, 0);
+        module.nodes.alive.assign(count, 1);
+        module.nodes.liveCount = count;
+        module.center = count > 0 ? Vector3Scale(sum, 1.0f / count) : Vector3{0.0f, 0.0f, 0.0f};
+        module.id = (int)m;
+    });
+    
+    // Lines within a module become node connections, deduplicated; the rest connect modules
+    std::vector<std::vector<uint64_t>> moduleEdges(moduleCount);
+    std::vector<CrossEdge> crossEdges;
+    for (const auto& range : ranges) {
+        for (size_t k = 0; k < range.lines.size(); k += 2) {
+            int a = range.lines[k];
+            int b = range.lines[k + 1];
+            int ma = moduleOf(a);
+            int mb = moduleOf(b);
+            if (ma == mb) {
+                a -= moduleStarts[ma];
+                b -= moduleStarts[ma];
+                if (a == b) continue;
+                if (a > b) std::swap(a, b);
+                moduleEdges[ma].push_back(((uint64_t)a << 32) | (uint32_t)b);
+            } else {
+                crossEdges.push_back({{ma, a - moduleStarts[ma]}, {mb, b - moduleStarts[mb]}});
+            }
+        }
+    }
+    ParallelFor(moduleCount, [&](size_t m) {
+        std::vector<uint64_t>& edges = moduleEdges[m];
+        std::sort(edges.begin(), edges.end());
+        edges.erase(std::unique(edges.begin(), edges.end()), edges.end());
+        NodeStore& nodes = loadedModules[m].nodes;
+        nodes.overflow.reserve(edges.size() * 2);
+        for (uint64_t edge : edges) {
+            nodes.overflow.push_back((int)(edge >> 32));
+            nodes.overflow.push_back((int)(uint32_t)edge);
+        }
+        std::vector<uint64_t>().swap(edges);
+        CompactAdjacency(nodes);
+    });
+    
+    SceneGraph loadedGraph;
+    for (const CrossEdge& edge : crossEdges) {
+        if (FindCrossEdge(loadedGraph, edge.a, edge.b) == -1) AddCrossEdge(loadedGraph, edge.a, edge.b);
+    }
+    
+    // Faces become walls when all their corners are in one module
+    int crossFaces = 0;
+    for (const auto& range : ranges) {
+        for (size_t f = 0; f < range.faceStarts.size(); f++) {
+            size_t first = range.faceStarts[f];
+            size_t last = f + 1 < range.faceStarts.size() ? range.faceStarts[f + 1] : range.faceIndices.size();
+            int m = moduleOf(range.faceIndices[first]);
+            Wall wall;
+            for (size_t k = first; k < last && m >= 0; k++) {
+                int vertex = range.faceIndices[k];
+                if (moduleOf(vertex) != m) m = -1;
+                else wall.nodeIndices.push_back(vertex - moduleStarts[m]);
+            }
+            if (m < 0) {
+                crossFaces++;
+                continue;
+            }
+            wall.id = NewWallId();
+            loadedModules[m].walls.push_back(std::move(wall));
+        }
+    }
+    
+    if (skipped > 0) printf("%s: skipped %d malformed records\n", filename, skipped);
+    if (crossFaces > 0) printf("%s: skipped %d faces spanning several modules\n", filename, crossFaces);
+    modules = std::move(loadedModules);
+    graph = std::move(loadedGraph);
+    nextModuleId = (int)moduleCount;
+    return true;
+}
+
+// glTF 2.0 binary export. Walls are fan-triangulated with the normals and
+// planar UVs the editor draws them with. Materials are double-sided, so back
+// faces are not written. Each module becomes one mesh whose data is a
+// contiguous range of the binary chunk: deduplicated vertex attributes shared
+// by one indexed primitive per material its walls use.
+struct GlbVertex {
+    float position[3];
+    float normal[3];
+    float uv[2];
+    bool operator==(const GlbVertex& other) const { return memcmp(this, &other, sizeof(GlbVertex)) == 0; }
+};
+
+struct GlbVertexHash {
+    size_t operator()(const GlbVertex& v) const {
+        const unsigned char* bytes = (const unsigned char*)&v;
+        uint64_t hash = 1469598103934665603ull; // FNV-1a
+        for (size_t i = 0; i < sizeof(GlbVertex); i++) hash = (hash ^ bytes[i]) * 1099511628211ull;
+        return (size_t)hash;
+    }
+};
+
+struct GlbWriter {
+    std::string nodes, meshes, materials, textures, images, bufferViews, accessors; // JSON array contents
+    int meshCount = 0, materialCount = 0, imageCount = 0, bufferViewCount = 0, accessorCount = 0;
+    std::vector<unsigned char> bin;
+};
+
+void AppendJsonItem(std::string& list, const std::string& item) {
+    if (!list.empty()) list += ',';
+    list += item;
+}
+
+std::string JsonString(const std::string& text) {
+    std::string out = "\"";
+    for (char c : text) {
+        if (c == '"' || c == '\\') {
+            out += '\\';
+            out += c;
+        } else if ((unsigned char)c < 0x20) {
+            char escaped[8];
+            snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+            out += escaped;
+        } else {
+            out += c;
+        }
+    }
+    return out + "\"";
+}
+
+std::string JsonFloats(const float* values, int count) {
+    std::string out = "[";
+    for (int i = 0; i < count; i++) {
+        if (i > 0) out += ',';
+        AppendObjFloat(out, values[i]);
+    }
+    return out + "]";
+}
+
+// Appends data to the binary chunk at a 4-byte boundary and returns its buffer view index
+int AddGlbBufferView(GlbWriter& glb, const void* data, size_t bytes, int target) {
+    glb.bin.resize((glb.bin.size() + 3) & ~(size_t)3, 0);
+    size_t offset = glb.bin.size();
+    glb.bin.insert(glb.bin.end(), (const unsigned char*)data, (const unsigned char*)data + bytes);
+    std::string view = "{\"buffer\":0,\"byteOffset\":" + std::to_string(offset) + ",\"byteLength\":" + std::to_string(bytes);
+    if (target != 0) view += ",\"target\":" + std::to_string(target);
+    AppendJsonItem(glb.bufferViews, view + "}");
+    return glb.bufferViewCount++;
+}
+
+int AddGlbAccessor(GlbWriter& glb, int view, int componentType, size_t count, const char* type, const std::string& bounds = "") {
+    std::string accessor = "{\"bufferView\":" + std::to_string(view) + ",\"componentType\":" + std::to_string(componentType) +
+                           ",\"count\":" + std::to_string(count) + ",\"type\":\"" + type + "\"" + bounds + "}";
+    AppendJsonItem(glb.accessors, accessor);
+    return glb.accessorCount++;
+}
+
+// Encoded image bytes for a wall texture: the source file when it is a format
+// glTF accepts, otherwise the texture read back from the GPU as PNG
+bool GetGlbImageData(const TextureAsset& asset, std::vector<unsigned char>& data, std::string& mimeType) {
+    const std::string& path = asset.path;
+    std::string extension = path.size() > 4 ? path.substr(path.size() - 4) : "";
+    for (auto& c : extension) c = (char)tolower(c);
+    if (!path.empty() && (extension == ".png" || extension == ".jpg" || extension == "jpeg") && FileExists(path.c_str())) {
+        int size = 0;
+        unsigned char* bytes = LoadFileData(path.c_str(), &size);
+        if (bytes) {
+            data.assign(bytes, bytes + size);
+            UnloadFileData(bytes);
+            mimeType = extension == ".png" ? "image/png" : "image/jpeg";
+            return true;
+        }
+    }
+    Image image = LoadImageFromTexture(asset.texture);
+    int size = 0;
+    unsigned char* bytes = ExportImageToMemory(image, ".png", &size);
+    UnloadImage(image);
+    if (!bytes) return false;
+    data.assign(bytes, bytes + size);
+    MemFree(bytes);
+    mimeType = "image/png";
+    return true;
+}
+
+// Textures are embedded, or referenced by their source path when embedTextures
+// is false; generated textures have no file and are always embedded
+bool ExportToGLB(const std::vector<GridModule>& modules, const char* filename, bool embedTextures) {
+    GlbWriter glb;
+    
+    // Material 0 is the untextured wall colour, the rest are one per distinct texture
+    auto linear = [](unsigned char c) { return powf(c / 255.0f, 2.2f); };
+    Color wallColor = {100, 100, 150, 180}; // As the editor draws untextured walls
+    float wallFactor[4] = {linear(wallColor.r), linear(wallColor.g), linear(wallColor.b), wallColor.a / 255.0f};
+    glb.materials = "{\"name\":\"Wall\",\"pbrMetallicRoughness\":{\"baseColorFactor\":" + JsonFloats(wallFactor, 4) +
+                    ",\"metallicFactor\":0,\"roughnessFactor\":1},\"alphaMode\":\"BLEND\",\"doubleSided\":true}";
+    glb.materialCount = 1;
+    std::unordered_map<const TextureAsset*, int> textureMaterials;
+    auto wallMaterial = [&](const Wall& wall) {
+        if (!wall.texture) return 0;
+        const TextureAsset* key = wall.texture.get();
+        const std::string& path = key->path;
+        auto found = textureMaterials.find(key);
+        if (found != textureMaterials.end()) return found->second;
+        
+        int image = glb.imageCount++;
+        if (!embedTextures && !path.empty()) {
+            AppendJsonItem(glb.images, "{\"uri\":" + JsonString(path) + "}");
+        } else {
+            std::vector<unsigned char> data;
+            std::string mimeType;
+            if (!GetGlbImageData(*key, data, mimeType)) {
+                glb.imageCount--;
+                return 0;
+            }
+            int view = AddGlbBufferView(glb, data.data(), data.size(), 0);
+            AppendJsonItem(glb.images, "{\"bufferView\":" + std::to_string(view) + ",\"mimeType\":\"" + mimeType + "\"}");
+        }
+        AppendJsonItem(glb.textures, "{\"sampler\":0,\"source\":" + std::to_string(image) + "}");
+        AppendJsonItem(glb.materials, "{\"pbrMetallicRoughness\":{\"baseColorTexture\":{\"index\":" + std::to_string(image) +
+                                      "},\"metallicFactor\":0,\"roughnessFactor\":1},\"doubleSided\":true}");
+        textureMaterials[key] = glb.materialCount;
+        return glb.materialCount++;
+    };
+    
+    std::vector<Vector3> polygon;
+    std::vector<uint32_t> corners;
+    std::vector<GlbVertex> vertices;
+    std::unordered_map<GlbVertex, uint32_t, GlbVertexHash> vertexIndex;
+    std::vector<std::vector<uint32_t>> materialIndices;
+    std::string sceneNodes;
+    for (const auto& module : modules) {
+        vertices.clear();
+        vertexIndex.clear();
+        for (auto& indices : materialIndices) indices.clear();
+        
+        for (const auto& wall : module.walls) {
+            if (wall.nodeIndices.size() < 3) continue;
+            polygon.clear();
+            for (int idx : wall.nodeIndices) {
+                if (IsNodeAlive(module.nodes, idx)) polygon.push_back(NodePosition(module.nodes, idx));
+            }
+            if (polygon.size() != wall.nodeIndices.size()) continue;
+            
+            Vector3 normal = WallNormal(polygon);
+            if (Vector3Length(normal) < 0.5f) normal = {0.0f, 1.0f, 0.0f}; // Degenerate first corner
+            WallUVFrame frame = ComputeWallUVFrame(polygon);
+            int material = wallMaterial(wall);
+            if ((int)materialIndices.size() <= material) materialIndices.resize(material + 1);
+            
+            corners.resize(polygon.size());
+            for (size_t i = 0; i < polygon.size(); i++) {
+                Vector2 uv = WallUV(frame, polygon[i]);
+                GlbVertex v = {{polygon[i].x, polygon[i].y, polygon[i].z}, {normal.x, normal.y, normal.z}, {uv.x, uv.y}};
+                auto inserted = vertexIndex.emplace(v, (uint32_t)vertices.size());
+                if (inserted.second) vertices.push_back(v);
+                corners[i] = inserted.first->second;
+            }
+            std::vector<uint32_t>& indices = materialIndices[material];
+            for (size_t i = 1; i + 1 < polygon.size(); i++) {
+                indices.push_back(corners[0]);
+                indices.push_back(corners[i]);
+                indices.push_back(corners[i + 1]);
+            }
+        }
+        if (vertices.empty()) continue;
+        
+        // Attributes as separate arrays so each accessor is tightly packed
+        size_t count = vertices.size();
+        std::vector<float> positions(count * 3), normals(count * 3), uvs(count * 2);
+        float minP[3] = {FLT_MAX, FLT_MAX, FLT_MAX}, maxP[3] = {-FLT_MAX, -FLT_MAX, -FLT_MAX};
+        for (size_t i = 0; i < count; i++) {
+            for (int k = 0; k < 3; k++) {
+                positions[i * 3 + k] = vertices[i].position[k];
+                normals[i * 3 + k] = vertices[i].normal[k];
+                minP[k] = std::min(minP[k], vertices[i].position[k]);
+                maxP[k] = std::max(maxP[k], vertices[i].position[k]);
+            }
+            uvs[i * 2 + 0] = vertices[i].uv[0];
+            uvs[i * 2 + 1] = vertices[i].uv[1];
+        }
+        const int FLOAT = 5126, UNSIGNED_INT = 5125, ARRAY_BUFFER = 34962, ELEMENT_ARRAY_BUFFER = 34963;
+        std::string bounds = ",\"min\":" + JsonFloats(minP, 3) + ",\"max\":" + JsonFloats(maxP, 3);
+        int position = AddGlbAccessor(glb, AddGlbBufferView(glb, positions.data(), positions.size() * sizeof(float), ARRAY_BUFFER), FLOAT, count, "VEC3", bounds);
+        int normal = AddGlbAccessor(glb, AddGlbBufferView(glb, normals.data(), normals.size() * sizeof(float), ARRAY_BUFFER), FLOAT, count, "VEC3");
+        int uv = AddGlbAccessor(glb, AddGlbBufferView(glb, uvs.data(), uvs.size() * sizeof(float), ARRAY_BUFFER), FLOAT, count, "VEC2");
+        std::string attributes = "{\"POSITION\":" + std::to_string(position) + ",\"NORMAL\":" + std::to_string(normal) +
+                                 ",\"TEXCOORD_0\":" + std::to_string(uv) + "}";
+        
+        std::string primitives;
+        for (size_t material = 0; material < materialIndices.size(); material++) {
+            const std::vector<uint32_t>& indices = materialIndices[material];
+            if (indices.empty()) continue;
+            int view = AddGlbBufferView(glb, indices.data(), indices.size() * sizeof(uint32_t), ELEMENT_ARRAY_BUFFER);
+            int accessor = AddGlbAccessor(glb, view, UNSIGNED_INT, indices.size(), "SCALAR");
+            AppendJsonItem(primitives, "{\"attributes\":" + attributes + ",\"indices\":" + std::to_string(accessor) +
+                                       ",\"material\":" + std::to_string(material) + "}");
+        }
+        
+        int mesh = glb.meshCount++;
+        std::string name = JsonString("Module " + std::to_string(module.id));
+        AppendJsonItem(glb.meshes, "{\"name\":" + name + ",\"primitives\":[" + primitives + "]}");
+        AppendJsonItem(glb.nodes, "{\"name\":" + name + ",\"mesh\":" + std::to_string(mesh) + "}");
+        AppendJsonItem(sceneNodes, std::to_string(mesh));
+    }
+    
+    // Empty arrays are not allowed, so sections without entries are left out
+    std::string json = "{\"asset\":{\"version\":\"2.0\",\"generator\":\"GreyScaleCube\"},\"scene\":0,\"scenes\":[{";
+    if (!sceneNodes.empty()) json += "\"nodes\":[" + sceneNodes + "]";
+    json += "}]";
+    auto section = [&](const char* name, const std::string& items) {
+        if (!items.empty()) json += std::string(",\"") + name + "\":[" + items + "]";
+    };
+    section("nodes", glb.nodes);
+    section("meshes", glb.meshes);
+    section("materials", glb.materials);
+    section("textures", glb.textures);
+    section("images", glb.images);
+    if (!glb.textures.empty()) json += ",\"samplers\":[{\"magFilter\":9729,\"minFilter\":9729,\"wrapS\":33071,\"wrapT\":33071}]";
+    glb.bin.resize((glb.bin.size() + 3) & ~(size_t)3, 0);
+    if (!glb.bin.empty()) json += ",\"buffers\":[{\"byteLength\":" + std::to_string(glb.bin.size()) + "}]";
+    section("bufferViews", glb.bufferViews);
+    section("accessors", glb.accessors);
+    json += "}";
+    json.resize((json.size() + 3) & ~(size_t)3, ' ');
+    
+    std::ofstream file(filename, std::ios::binary);
+    if (!file.is_open()) return false;
+    uint32_t jsonLength = (uint32_t)json.size();
+    uint32_t binLength = (uint32_t)glb.bin.size();
+    uint32_t totalLength = 12 + 8 + jsonLength + (binLength > 0 ? 8 + binLength : 0);
+    uint32_t header[5] = {0x46546C67, 2, totalLength, jsonLength, 0x4E4F534A}; // "glTF", version, length, JSON chunk
+    file.write((const char*)header, sizeof(header));
+    file.write(json.data(), jsonLength);
+    if (binLength > 0) {
+        uint32_t binHeader[2] = {binLength, 0x004E4942}; // BIN chunk
+        file.write((const char*)binHeader, sizeof(binHeader));
+        file.write((const char*)glb.bin.data(), binLength);
+    }
+    file.close();
+    return !file.fail();
+}
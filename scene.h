@@ -0,0 +1,610 @@
+// Scene model of the editor: modules of nodes, connections and walls, picking,
+// the edit journal and file formats. Nothing here opens a window or draws, so
+// tools and benchmarks can link it without one.
+#pragma once
+
+#include "raylib.h"
+#include "raymath.h"
+#include "ray_kernels.h"
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <deque>
+#include <string>
+#include <memory>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <unordered_map>
+
+struct NodeHandle {
+    int slot = -1;
+    uint32_t generation = 0;
+};
+
+// Array that either owns its elements or views read-only memory mapped from a
+// project or page file. The first write copies the view into owned storage, so
+// loading copies nothing and modules that are never edited keep reading from the file.
+template <typename T>
+struct MappedArray {
+    std::vector<T> owned;
+    const T* view = nullptr;
+    size_t viewSize = 0;
+    std::shared_ptr<const void> mapping; // Keeps the viewed file mapped
+    
+    size_t size() const { return view ? viewSize : owned.size(); }
+    bool empty() const { return size() == 0; }
+    bool viewed() const { return view != nullptr; }
+    size_t ownedBytes() const { return owned.capacity() * sizeof(T); }
+    const T* data() const { return view ? view : owned.data(); }
+    const T& operator[](size_t i) const { return view ? view[i] : owned[i]; }
+    T& operator[](size_t i) { detach(); return owned[i]; }
+    void push_back(const T& value) { detach(); owned.push_back(value); }
+    void reserve(size_t n) { detach(); owned.reserve(n); }
+    void resize(size_t n) { detach(); owned.resize(n); }
+    void assign(size_t n, const T& value) { dropView(); owned.assign(n, value); }
+    void swap(std::vector<T>& other) { dropView(); owned.swap(other); }
+    
+    void setView(const T* data, size_t n, std::shared_ptr<const void> file) {
+        owned.clear();
+        owned.shrink_to_fit();
+        view = data;
+        viewSize = n;
+        mapping = std::move(file);
+    }
+    void detach() {
+        if (!view) return;
+        owned.assign(view, view + viewSize);
+        dropView();
+    }
+    void dropView() {
+        view = nullptr;
+        viewSize = 0;
+        mapping.reset();
+    }
+};
+
+// Regular lattice: node (x, y, z) sits at origin + (x, y, z) * spacing, has index
+// x + y * sizeX + z * sizeX * sizeY and is connected to its axis neighbours
+struct LatticeParams {
+    int sizeX = 0, sizeY = 0, sizeZ = 0;
+    Vector3 origin = {0.0f, 0.0f, 0.0f};
+    Vector3 spacing = {0.0f, 0.0f, 0.0f};
+};
+
+// Node positions as separate coordinate arrays, with undirected connections in
+// compressed sparse row form. Each edge appears in the rows of both endpoints.
+// Edges added since the last compaction live in the flat overflow list and
+// removed CSR entries are set to -1, so edits never reallocate per node.
+// Deleted nodes leave a dead slot behind that later additions reuse, so node
+// indices stay stable until CompactNodeSlots closes the gaps.
+// A store can also stand for a whole lattice by its parameters alone, with
+// every array empty; the first edit materialises it, much as a MappedArray
+// copies its view on the first write.
+struct NodeStore {
+    MappedArray<float> x, y, z;
+    MappedArray<int> offsets;  // Row starts; nodes at or past offsets.size() - 1 have no row yet
+    MappedArray<int> targets;  // Neighbour indices, -1 for removed entries
+    std::vector<int> overflow; // Edges added since compaction, as (a, b) pairs
+    int removedCount = 0;      // -1 entries waiting in targets
+    MappedArray<uint32_t> generation; // Bumped when a slot dies so old handles stop resolving
+    MappedArray<uint8_t> alive;
+    std::vector<int> freeSlots;       // Dead slots, most recently freed last
+    int liveCount = 0;
+    bool implicitLattice = false; // Nodes and connections follow from 'lattice'
+    LatticeParams lattice;
+};
+
+// One image in the TextureCache. Walls share it through shared_ptr, so copies
+// of a wall held by the edit journal keep it loaded too. While the file is
+// still being decoded 'texture' is the cache's placeholder.
+struct TextureAsset {
+    Texture2D texture = {};
+    std::string path;          // File it was first loaded from, empty for generated textures
+    uint64_t contentHash = 0;  // Of the file bytes, or of the generator parameters
+    size_t gpuBytes = 0;       // Zero while loading and when the texture belongs to sharedWith
+    uint64_t lastUsed = 0;     // Cache tick when a wall last referenced it
+    bool loading = false;
+    std::shared_ptr<TextureAsset> sharedWith; // Identical image loaded earlier, whose upload this reuses
+};
+
+struct Wall {
+    std::vector<int> nodeIndices; // Can be 3, 4, or more nodes
+    std::shared_ptr<TextureAsset> texture; // Null when the wall is untextured
+    unsigned int id; // Unique per wall, keys the GPU mesh cache
+};
+
+struct BVHNode {
+    BoundingBox bounds;
+    int left;  // Child node indices, -1 for leaves
+    int right;
+    int first; // First entry in BVH::prims (leaves only)
+    int count;
+};
+
+struct BVH {
+    std::vector<BVHNode> nodes;  // nodes[0] is the root; children always come after their parent
+    std::vector<int> prims;      // Primitive ids grouped by leaf
+    std::vector<int> parent;     // Parent of each node, -1 for the root
+    std::vector<int> primLeaf;   // Leaf holding each primitive id
+};
+
+struct WallTriangle {
+    int wall;
+    int corner; // Fan triangle (0, corner, corner + 1)
+};
+
+// Picking acceleration for one module. Node leaves are point bounds, the pick
+// radius is added at query time so the same tree serves any sphere radius.
+struct ModulePickBVH {
+    BVH nodeTree;
+    BVH wallTree;
+    std::vector<WallTriangle> triangles;
+    TrianglePack packed;         // Triangle wallTree.prims[j] at j, so each leaf is a contiguous run
+    bool needsRebuild = true;    // Nodes or walls were added/removed
+    bool wallsNeedRefit = false; // Node positions changed under the wall tree
+    bool boundsChanged = false;  // Module bounds moved, scene tree must refit this leaf
+};
+
+// Uniform grid of node indices for radius and nearest-neighbour queries.
+// Cells are computed relative to 'origin' so translating a module only moves the origin.
+struct SpatialHash {
+    std::unordered_map<uint64_t, std::vector<int>> cells;
+    std::vector<uint64_t> nodeCell; // Cell key of each node
+    Vector3 origin = {0.0f, 0.0f, 0.0f};
+    bool needsRebuild = true;
+};
+
+// Walls of a module by shape and by node, so duplicate checks and node deletion
+// only look at the walls involved. Walls are removed by moving the last wall into
+// the gap, which keeps every other position valid. Rebuilt when needsRebuild is
+// set or the wall list changed size without going through InsertWall/RemoveWall.
+struct WallIndex {
+    std::unordered_multimap<uint64_t, int> byShape;   // Hash of the sorted node list -> wall
+    std::unordered_map<int, std::vector<int>> byNode; // Node -> walls using it
+    size_t wallCount = 0;
+    bool needsRebuild = true;
+};
+
+// Revisions are unique across all modules, so two modules (or two undo states of
+// one module) with the same revision always hold the same geometry
+unsigned int NextModuleRevision();
+
+struct GridModule {
+    NodeStore nodes;
+    std::vector<Wall> walls;
+    Vector3 center;
+    int id;
+    ModulePickBVH pick;
+    SpatialHash spatial;
+    WallIndex wallIndex;
+    unsigned int revision = NextModuleRevision(); // Changed by every edit, see MarkModuleChanged
+    bool paged = false; // Paged out by the ScenePager: picking and drawing skip it
+};
+
+// Top level picking tree, one leaf per module (primitive id = module index)
+struct ScenePickBVH {
+    BVH tree;
+    std::vector<int> moduleIds; // Module ids the tree was built for, by index
+};
+
+// Camera view volume as six inward-facing unit planes: dot(xyz, p) + w >= 0 inside
+struct Frustum {
+    Vector4 planes[6];
+};
+
+enum FrustumTest { FRUSTUM_OUTSIDE, FRUSTUM_INTERSECTS, FRUSTUM_INSIDE };
+
+// A node slot in a particular module
+struct NodeRef {
+    int moduleId = -1;
+    int node = -1;
+};
+
+struct CrossEdge {
+    NodeRef a, b;
+};
+
+// Connections between nodes of different modules. Connections inside a module
+// live in its NodeStore; these are keyed by module id and node slot, so they
+// survive module reordering. Freed edge slots have moduleId -1 and are reused.
+struct SceneGraph {
+    std::vector<CrossEdge> edges;
+    std::vector<int> freeEdges;
+    std::unordered_map<uint64_t, std::vector<int>> nodeEdges; // Edge indices at each node
+    std::unordered_map<int, std::vector<int>> moduleEdges;     // Edge indices touching each module
+    int edgeCount = 0;
+};
+
+enum EditType {
+    EDIT_ADD_NODE,
+    EDIT_DELETE_NODE,
+    EDIT_MOVE_NODE,
+    EDIT_MOVE_MODULE,
+    EDIT_CONNECT,
+    EDIT_CREATE_WALL,
+    EDIT_DELETE_WALL,
+    EDIT_SET_TEXTURE,
+    EDIT_ADD_MODULE,
+    EDIT_DELETE_MODULE
+};
+
+// Walls are put back in the reverse of the order they were removed in
+struct RemovedWall {
+    int index; // Position in module.walls before removal
+    Wall wall;
+};
+
+// One undoable edit. Only the fields used by its type are set, so the journal
+// grows with the size of each edit rather than the size of the scene.
+struct EditCommand {
+    EditType type;
+    int moduleId = -1;
+    int moduleIndex = -1;            // ADD/DELETE_MODULE: position in the module list
+    int node = -1;                   // ADD/DELETE/MOVE_NODE, first node of CONNECT
+    int otherNode = -1;              // CONNECT: second node
+    int otherModuleId = -1;          // CONNECT: module of the second node when it differs
+    int wall = -1;                   // CREATE/DELETE_WALL, SET_TEXTURE
+    Vector3 from = {0.0f, 0.0f, 0.0f}; // MOVE_NODE start position
+    Vector3 to = {0.0f, 0.0f, 0.0f};   // MOVE_NODE end position, MOVE_MODULE delta
+    Vector3 removedPosition = {0.0f, 0.0f, 0.0f}; // DELETE_NODE
+    std::vector<int> neighbors;      // DELETE_NODE: nodes the removed node was connected to
+    std::vector<RemovedWall> walls;  // DELETE_NODE, DELETE_WALL, undone CREATE_WALL
+    std::vector<CrossEdge> crossEdges; // DELETE_NODE, DELETE_MODULE: connections to other modules
+    std::shared_ptr<TextureAsset> oldTexture; // SET_TEXTURE
+    std::shared_ptr<TextureAsset> newTexture;
+    std::unique_ptr<GridModule> module; // ADD/DELETE_MODULE while the module is out of the scene
+    int nextModuleIdBefore = 0;
+    int nextModuleIdAfter = 0;
+};
+
+struct EditJournal {
+    std::deque<EditCommand> undoStack;
+    std::vector<EditCommand> redoStack;
+    size_t maxHistory = 50;
+};
+
+struct TextureLoadJob {
+    std::shared_ptr<TextureAsset> asset;
+    std::string path;
+    int maxSize;
+};
+
+// A decoded image waiting for its GPU upload; image.data is null if decoding failed
+struct DecodedTexture {
+    std::shared_ptr<TextureAsset> asset;
+    Image image = {};
+    uint64_t contentHash = 0;
+};
+
+// Worker thread that reads and decodes image files, including mipmaps, so the
+// editor only does the upload
+struct TextureLoader {
+    std::thread worker;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::deque<TextureLoadJob> jobs;
+    std::vector<DecodedTexture> decoded;
+    bool stopping = false;
+    ~TextureLoader();
+};
+
+// Textures by path and content hash, so walls using the same image share one
+// upload. Assets no wall references stay loaded for reuse until the resident
+// total exceeds the budget, then the least recently used of them are unloaded.
+struct TextureCache {
+    struct PathEntry {
+        std::weak_ptr<TextureAsset> asset;
+        long modTime = 0;
+    };
+    std::vector<std::shared_ptr<TextureAsset>> assets; // The cache's own reference to each
+    std::unordered_map<std::string, PathEntry> byPath;
+    std::unordered_map<uint64_t, std::weak_ptr<TextureAsset>> byHash;
+    size_t budgetBytes = (size_t)256 << 20;
+    size_t residentBytes = 0;
+    uint64_t tick = 0;
+    int maxTextureSize = 4096;       // Larger images are scaled down while decoding
+    Texture2D placeholder = {};      // Shown on walls whose texture is still loading
+    std::unique_ptr<TextureLoader> loader; // Started by the first request
+};
+
+// Keeps the modules near the camera, and those the edit journal refers to,
+// resident. Modules are grouped into cubic chunks by their centre; while the
+// resident total is over budget, the least recently wanted chunks are paged
+// out. Paging out writes node data that changed since it was last read from a
+// file to the module's page file and views that instead, then drops picking
+// and the spatial hash. Paged modules stay in the module list, so indices,
+// saving and export are unaffected. Where files are read rather than mapped
+// (Windows) a page comes back into memory, so only picking and the hash are freed.
+struct ScenePager {
+    std::string pathPrefix = "scene.page"; // Module id N pages to pathPrefix + N
+    size_t budgetBytes = (size_t)1 << 30;
+    float chunkSize = 64.0f;
+    float streamRadius = 400.0f;   // Chunks this close to the focus are always resident
+    size_t residentBytes = 0;      // As of the last UpdateScenePaging
+    int pagedModules = 0;
+    uint64_t tick = 0;
+    std::unordered_map<uint64_t, uint64_t> chunkUsed; // Chunk key -> tick it was last wanted
+    std::unordered_map<int, int> pageWrites;          // Module id -> times its page file was written
+    std::vector<uint64_t> moduleChunks;               // Chunk key of each module, by index
+};
+
+// Planar UV projection of a wall: the polygon's bounding box mapped onto the
+// unit square along the two axes it spans most
+struct WallUVFrame {
+    Vector3 min;
+    Vector3 range;
+    int u, v; // Axes (0 = x, 1 = y, 2 = z) used for each texture coordinate
+};
+
+// What the OBJ exporter needs from one module, copied so export can run while the scene is edited
+struct ObjExportModule {
+    int id;
+    NodeStore nodes;
+    std::vector<int> wallStarts;  // Wall w uses wallIndices[wallStarts[w], wallStarts[w + 1])
+    std::vector<int> wallIndices;
+};
+
+// Formatted text of one module; kept between exports so the buffers are reused
+struct ObjModuleChunk {
+    std::string vertices;
+    std::string lines;
+    std::string faces;
+    std::vector<int> vertexIndex; // OBJ vertex number of every node slot, -1 for dead slots
+};
+
+// Formats modules in parallel and writes the file on a background thread
+struct ObjExporter {
+    std::vector<ObjExportModule> modules;
+    std::vector<CrossEdge> crossEdges;
+    std::vector<ObjModuleChunk> chunks;
+    std::string crossLines;
+    std::string filename;
+    std::thread worker;
+    std::atomic<bool> finished{false};
+    bool running = false;
+    bool succeeded = false;
+};
+
+// Node store
+int NodeCount(const NodeStore& store);
+bool IsNodeAlive(const NodeStore& store, int i);
+NodeHandle GetNodeHandle(const NodeStore& store, int i);
+int ResolveNodeHandle(const NodeStore& store, NodeHandle handle);
+Vector3 NodePosition(const NodeStore& store, int i);
+void SetNodePosition(NodeStore& store, int i, Vector3 p);
+void PushNode(NodeStore& store, Vector3 p);
+int CompactedRowCount(const NodeStore& store);
+bool HasEdge(const NodeStore& store, int a, int b);
+void CompactAdjacency(NodeStore& store);
+void MaybeCompactAdjacency(NodeStore& store);
+void AddEdge(NodeStore& store, int a, int b);
+void RemoveEdge(NodeStore& store, int a, int b);
+int AllocNode(NodeStore& store, Vector3 p);
+void ReviveNode(NodeStore& store, int slot, Vector3 p);
+void KillNode(NodeStore& store, int slot);
+std::vector<int> CompactNodeSlots(NodeStore& store, const std::vector<uint8_t>& keep);
+// Lattice of sizeX * sizeY * sizeZ nodes centred on 'center', 'spacing' apart along
+// each axis and connected to their axis neighbours. Node i sits at x + y * sizeX + z * sizeX * sizeY.
+NodeStore Create3DGridStructure(Vector3 center, int sizeX, int sizeY, int sizeZ, Vector3 spacing);
+// Cube of gridDimension^3 nodes spanning totalSize
+NodeStore Create3DGridStructure(Vector3 center, float totalSize, int gridDimension);
+// The same lattices kept implicit: O(1) memory until MaterializeNodeStore
+NodeStore CreateImplicitGrid(Vector3 center, int sizeX, int sizeY, int sizeZ, Vector3 spacing);
+NodeStore CreateImplicitGrid(Vector3 center, float totalSize, int gridDimension);
+void MaterializeNodeStore(NodeStore& store);
+int LatticeNodeCount(const LatticeParams& lattice);
+Vector3 LatticeNodePosition(const LatticeParams& lattice, int i);
+BoundingBox LatticeBounds(const LatticeParams& lattice);
+
+// Calls fn(neighbour) for every axis neighbour of lattice node i, in the order
+// Create3DGridStructure stores them
+template <typename Fn>
+void ForEachLatticeNeighbor(const LatticeParams& lattice, int i, Fn fn) {
+    int layer = lattice.sizeX * lattice.sizeY;
+    int x = i % lattice.sizeX, y = (i / lattice.sizeX) % lattice.sizeY, z = i / layer;
+    if (x > 0) fn(i - 1);
+    if (x < lattice.sizeX - 1) fn(i + 1);
+    if (y > 0) fn(i - lattice.sizeX);
+    if (y < lattice.sizeY - 1) fn(i + lattice.sizeX);
+    if (z > 0) fn(i - layer);
+    if (z < lattice.sizeZ - 1) fn(i + layer);
+}
+
+// Calls fn(neighbour) for every connection of node i
+template <typename Fn>
+void ForEachNeighbor(const NodeStore& store, int i, Fn fn) {
+    if (store.implicitLattice) {
+        ForEachLatticeNeighbor(store.lattice, i, fn);
+        return;
+    }
+    if (i < CompactedRowCount(store)) {
+        for (int k = store.offsets[i]; k < store.offsets[i + 1]; k++) {
+            if (store.targets[k] >= 0) fn(store.targets[k]);
+        }
+    }
+    for (size_t k = 0; k < store.overflow.size(); k += 2) {
+        if (store.overflow[k] == i) fn(store.overflow[k + 1]);
+        else if (store.overflow[k + 1] == i) fn(store.overflow[k]);
+    }
+}
+
+// Calls fn(a, b) once per connection
+template <typename Fn>
+void ForEachEdge(const NodeStore& store, Fn fn) {
+    if (store.implicitLattice) {
+        int count = LatticeNodeCount(store.lattice);
+        for (int i = 0; i < count; i++) {
+            ForEachLatticeNeighbor(store.lattice, i, [&](int n) { if (n > i) fn(i, n); });
+        }
+        return;
+    }
+    int rows = CompactedRowCount(store);
+    for (int i = 0; i < rows; i++) {
+        for (int k = store.offsets[i]; k < store.offsets[i + 1]; k++) {
+            if (store.targets[k] > i) fn(i, store.targets[k]);
+        }
+    }
+    for (size_t k = 0; k < store.overflow.size(); k += 2) {
+        fn(store.overflow[k], store.overflow[k + 1]);
+    }
+}
+
+// Modules, spatial queries and picking
+void MarkModuleChanged(GridModule& module);
+void RebuildSpatialHash(GridModule& module);
+void SpatialHashMove(GridModule& module, int nodeIdx);
+void SpatialHashRemove(GridModule& module, int nodeIdx);
+int FindNearestNode(const GridModule& module, Vector3 p, float maxDist, float* outDist = nullptr);
+BoundingBox EmptyBounds();
+bool IsEmptyBounds(const BoundingBox& box);
+BoundingBox MergeBounds(const BoundingBox& a, const BoundingBox& b);
+float AxisValue(Vector3 v, int axis);
+void BuildBVH(BVH& bvh, const std::vector<BoundingBox>& primBounds, int leafSize = 4);
+BoundingBox GetModuleBounds(const GridModule& module);
+BoundingBox GetNodeBounds(const GridModule& module, int i);
+void RebuildModulePicking(GridModule& module);
+void InvalidateModulePicking(GridModule& module);
+void InvalidateScenePicking(ScenePickBVH& scene);
+void MoveNode(GridModule& module, int nodeIdx, Vector3 position);
+void TranslateModule(GridModule& module, Vector3 delta);
+void UpdateScenePicking(std::vector<GridModule>& modules, ScenePickBVH& scene);
+int GetNodeUnderRay(const GridModule& module, const Ray& ray, float sphereRadius);
+int GetModuleUnderRay(const std::vector<GridModule>& modules, const ScenePickBVH& scene, const Ray& ray, float sphereRadius);
+int GetWallUnderRay(const GridModule& module, const Ray& ray);
+int FindClosestModule(const std::vector<GridModule>& modules, const ScenePickBVH& scene, Vector3 position, float maxDist);
+void ConnectNodeToNearby(GridModule& module, int newNodeIndex, float connectionDistance);
+void ConnectNodeToNearbyAcrossModules(std::vector<GridModule>& modules, SceneGraph& graph, const ScenePickBVH& scene,
+                                      int targetModuleIndex, int newNodeIndex, float connectionDistance);
+
+// Paging
+size_t ModuleResidentBytes(const GridModule& module);
+bool PageOutModule(ScenePager& pager, GridModule& module);
+void PageInModule(GridModule& module);
+void UpdateScenePaging(ScenePager& pager, std::vector<GridModule>& modules, const EditJournal& journal, Vector3 focus);
+void RemoveScenePages(ScenePager& pager);
+
+// Visibility
+Frustum MakeCameraFrustum(const Camera3D& camera, float aspect, float nearPlane, float farPlane);
+FrustumTest TestFrustumBounds(const Frustum& frustum, const BoundingBox& bounds, float inflate = 0.0f);
+float PixelsPerUnit(const Camera3D& camera, float viewportHeight, Vector3 position);
+
+// Calls fn(prim) for the primitives of every leaf that may be in view, with the
+// leaf bounds grown by inflate. Subtrees wholly inside are not tested further.
+template <typename Fn>
+void ForEachBVHPrimInFrustum(const BVH& bvh, const Frustum& frustum, float inflate, Fn fn) {
+    if (bvh.nodes.empty()) return;
+    
+    struct StackEntry { int node; bool inside; };
+    StackEntry stack[64];
+    int stackSize = 0;
+    stack[stackSize++] = {0, false};
+    
+    while (stackSize > 0) {
+        StackEntry top = stack[--stackSize];
+        const BVHNode& node = bvh.nodes[top.node];
+        bool inside = top.inside;
+        if (!inside) {
+            FrustumTest test = TestFrustumBounds(frustum, node.bounds, inflate);
+            if (test == FRUSTUM_OUTSIDE) continue;
+            inside = test == FRUSTUM_INSIDE;
+        }
+        
+        if (node.left < 0) {
+            for (int i = node.first; i < node.first + node.count; i++) fn(bvh.prims[i]);
+        } else {
+            stack[stackSize++] = {node.right, inside};
+            stack[stackSize++] = {node.left, inside};
+        }
+    }
+}
+
+// Calls fn(node) for the nodes of a module that may be in view, as
+// ForEachBVHPrimInFrustum over its node tree. An implicit lattice has no node
+// tree, so its layers and rows are tested instead.
+template <typename Fn>
+void ForEachNodeInFrustum(const GridModule& module, const Frustum& frustum, float inflate, Fn fn) {
+    const NodeStore& nodes = module.nodes;
+    if (!nodes.implicitLattice) {
+        ForEachBVHPrimInFrustum(module.pick.nodeTree, frustum, inflate, fn);
+        return;
+    }
+    
+    const LatticeParams& lattice = nodes.lattice;
+    int layer = lattice.sizeX * lattice.sizeY;
+    auto spanBounds = [&](int first, int last) {
+        Vector3 a = LatticeNodePosition(lattice, first), b = LatticeNodePosition(lattice, last);
+        return BoundingBox{Vector3Min(a, b), Vector3Max(a, b)};
+    };
+    for (int z = 0; z < lattice.sizeZ; z++) {
+        FrustumTest layerTest = TestFrustumBounds(frustum, spanBounds(z * layer, (z + 1) * layer - 1), inflate);
+        if (layerTest == FRUSTUM_OUTSIDE) continue;
+        for (int y = 0; y < lattice.sizeY; y++) {
+            int first = z * layer + y * lattice.sizeX;
+            int last = first + lattice.sizeX - 1;
+            if (layerTest == FRUSTUM_INTERSECTS &&
+                TestFrustumBounds(frustum, spanBounds(first, last), inflate) == FRUSTUM_OUTSIDE) continue;
+            for (int i = first; i <= last; i++) fn(i);
+        }
+    }
+}
+
+// Connections between modules
+int AddCrossEdge(SceneGraph& graph, NodeRef a, NodeRef b);
+void RemoveCrossEdge(SceneGraph& graph, int e);
+int FindCrossEdge(const SceneGraph& graph, NodeRef a, NodeRef b);
+void RemoveNodeCrossEdges(SceneGraph& graph, NodeRef ref, std::vector<CrossEdge>* removed);
+void RemoveModuleCrossEdges(SceneGraph& graph, int moduleId, std::vector<CrossEdge>* removed);
+void RemapModuleCrossEdges(SceneGraph& graph, int moduleId, const std::vector<int>& remap);
+
+template <typename Fn>
+void ForEachCrossEdge(const SceneGraph& graph, Fn fn) {
+    for (const auto& edge : graph.edges) {
+        if (edge.a.moduleId >= 0) fn(edge.a, edge.b);
+    }
+}
+
+// Scene edits and the journal
+bool AreNodesCoplanar(const NodeStore& nodes, const std::vector<int>& indices);
+bool FormValidPolygon(const NodeStore& nodes, const std::vector<int>& indices);
+unsigned int NewWallId();
+bool CreateWallFromSelectedNodes(GridModule& module, const std::vector<int>& selected);
+int AddNode(GridModule& module, Vector3 position);
+void DeleteNode(GridModule& module, int nodeIdx);
+void RestoreNode(GridModule& module, int nodeIdx, Vector3 position, const std::vector<int>& neighbors);
+int FindModuleIndex(const std::vector<GridModule>& modules, int moduleId);
+void InsertWall(GridModule& module, int wallIdx, const Wall& wall);
+void RemoveWall(GridModule& module, int wallIdx);
+const std::vector<int>& WallsUsingNode(GridModule& module, int nodeIdx);
+EditCommand MakeEdit(EditType type, int moduleId);
+void RecordEdit(EditJournal& journal, EditCommand&& cmd);
+void ClearJournal(EditJournal& journal);
+bool PerformEdit(EditJournal& journal, std::vector<GridModule>& modules, SceneGraph& graph, int& nextModuleId, EditCommand&& cmd);
+bool UndoEdit(EditJournal& journal, std::vector<GridModule>& modules, SceneGraph& graph, int& nextModuleId);
+bool RedoEdit(EditJournal& journal, std::vector<GridModule>& modules, SceneGraph& graph, int& nextModuleId);
+bool ModuleNeedsCompaction(const GridModule& module);
+void CompactModuleNodes(GridModule& module, SceneGraph& graph, EditJournal& journal);
+
+// Wall textures
+std::shared_ptr<TextureAsset> RequestTexture(TextureCache& cache, const std::string& path);
+std::shared_ptr<TextureAsset> AcquireSolidTexture(TextureCache& cache, Color color, int width, int height);
+int UploadDecodedTextures(TextureCache& cache, double budgetMs);
+int TexturesLoading(const TextureCache& cache);
+void TrimTextureCache(TextureCache& cache);
+void UnloadTextureCache(TextureCache& cache);
+
+// Wall surface geometry
+Vector3 WallNormal(const std::vector<Vector3>& vertices);
+WallUVFrame ComputeWallUVFrame(const std::vector<Vector3>& vertices);
+Vector2 WallUV(const WallUVFrame& frame, Vector3 p);
+
+// Files
+bool StartObjExport(ObjExporter& exporter, const std::vector<GridModule>& modules, const SceneGraph& graph, const char* filename);
+bool PollObjExport(ObjExporter& exporter);
+void WaitObjExport(ObjExporter& exporter);
+bool ExportToOBJ(const std::vector<GridModule>& modules, const SceneGraph& graph, const char* filename);
+bool ImportOBJ(const char* filename, std::vector<GridModule>& modules, SceneGraph& graph, int& nextModuleId);
+bool SaveProject(std::vector<GridModule>& modules, const SceneGraph& graph, int nextModuleId, const char* filename);
+bool LoadProject(const char* filename, std::vector<GridModule>& modules, SceneGraph& graph, int& nextModuleId, TextureCache& textures);
+bool ExportToGLB(const std::vector<GridModule>& modules, const char* filename, bool embedTextures = true);